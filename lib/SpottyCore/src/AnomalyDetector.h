@@ -0,0 +1,145 @@
+#ifndef __ANOMALY_DETECTOR_H__
+#define __ANOMALY_DETECTOR_H__
+
+#include <stdint.h>
+
+enum SensorFault
+{
+  FAULT_NONE,
+  FAULT_STUCK_HIGH,
+  FAULT_FLOOD,
+  FAULT_SILENCE
+};
+
+struct AnomalyConfig
+{
+  uint32_t stuckHighMs;
+  uint32_t edgeRateFloor;
+  uint32_t edgeRateFactor;
+  uint32_t silenceMs;
+  uint32_t silenceMinRate;
+};
+
+/*
+* Constant-memory PIR health check: stuck level, edge rate outside the band
+* learned for the hour of day, and silence during normally busy hours.
+* Pass hour = -1 while wall-clock time is unknown; only the floor applies.
+*/
+struct AnomalyDetector
+{
+  AnomalyConfig config;
+  // Expected edges per minute for each hour of the day, EWMA scaled by 16
+  uint16_t expectedRate[24];
+  SensorFault fault;
+  uint32_t windowStart;
+  uint32_t windowEdges;
+  uint32_t highSince;
+  uint32_t lastEdge;
+  uint32_t seenEdges;
+  bool high;
+
+  void begin(const AnomalyConfig& cfg, uint32_t nowMs)
+  {
+    config = cfg;
+    for(int i = 0; i < 24; i++)
+    {
+      expectedRate[i] = 0;
+    }
+    fault = FAULT_NONE;
+    windowStart = nowMs;
+    windowEdges = 0;
+    highSince = 0;
+    lastEdge = nowMs;
+    seenEdges = 0;
+    high = false;
+  }
+
+  SensorFault update(uint32_t nowMs, uint32_t edges, bool levelHigh, int hour)
+  {
+    if(edges != seenEdges)
+    {
+      seenEdges = edges;
+      lastEdge = nowMs;
+      if(fault == FAULT_SILENCE)
+      {
+        fault = FAULT_NONE;
+      }
+    }
+
+    // Stuck HIGH: a PIR output holds for seconds, not many minutes
+    if(levelHigh)
+    {
+      if(!high)
+      {
+        high = true;
+        highSince = nowMs;
+      }
+      else if(nowMs - highSince > config.stuckHighMs)
+      {
+        fault = FAULT_STUCK_HIGH;
+      }
+    }
+    else
+    {
+      high = false;
+      if(fault == FAULT_STUCK_HIGH)
+      {
+        fault = FAULT_NONE;
+      }
+    }
+
+    if(nowMs - windowStart >= 60000UL)
+    {
+      closeWindow(edges - windowEdges, hour);
+      windowStart = nowMs;
+      windowEdges = edges;
+    }
+
+    // Sudden silence only counts during hours that are normally busy
+    if(fault == FAULT_NONE && hour >= 0 && nowMs - lastEdge > config.silenceMs &&
+       expectedRate[hour] >= config.silenceMinRate * 16)
+    {
+      fault = FAULT_SILENCE;
+    }
+    return fault;
+  }
+
+  // True while motion events should be suppressed. Silence is only reported.
+  bool suppressing() const
+  {
+    return fault == FAULT_STUCK_HIGH || fault == FAULT_FLOOD;
+  }
+
+  // Close a one minute window: compare its edge count with the band for
+  // this hour, and learn from it when the sensor looks healthy.
+  void closeWindow(uint32_t edges, int hour)
+  {
+    uint32_t limit = config.edgeRateFloor;
+    if(hour >= 0)
+    {
+      uint32_t band = (uint32_t)expectedRate[hour] * config.edgeRateFactor / 16;
+      if(band > limit)
+      {
+        limit = band;
+      }
+    }
+
+    if(edges > limit)
+    {
+      fault = FAULT_FLOOD;
+      return;
+    }
+    if(fault == FAULT_FLOOD)
+    {
+      fault = FAULT_NONE;
+    }
+
+    if(hour >= 0 && fault == FAULT_NONE)
+    {
+      int32_t scaled = (int32_t)(edges < 4095 ? edges : 4095) * 16;
+      expectedRate[hour] = (uint16_t)(expectedRate[hour] + (scaled - (int32_t)expectedRate[hour]) / 16);
+    }
+  }
+};
+
+#endif // __ANOMALY_DETECTOR_H__
@@ -0,0 +1,94 @@
+#ifndef __BROKER_SELECTOR_H__
+#define __BROKER_SELECTOR_H__
+
+#include <stdint.h>
+
+#define BROKER_MAX 4
+
+/*
+* Health-aware choice among a short list of MQTT brokers. A broker that
+* fails to connect backs off exponentially; among the brokers not backing
+* off the one with the fewest consecutive failures wins, then the fastest
+* to connect, then the earliest in the list.
+*/
+struct BrokerSelector
+{
+  uint8_t count;
+  uint32_t backoffMs;
+  uint32_t maxBackoffMs;
+  uint8_t failures[BROKER_MAX];
+  // EWMA of connect time, weight 1/4; 0 until the first success
+  uint32_t connectMs[BROKER_MAX];
+  uint32_t retryAt[BROKER_MAX];
+
+  void begin(uint8_t brokers, uint32_t baseBackoffMs, uint32_t limitMs)
+  {
+    count = brokers < BROKER_MAX ? brokers : BROKER_MAX;
+    backoffMs = baseBackoffMs;
+    maxBackoffMs = limitMs;
+    for(uint8_t i = 0; i < BROKER_MAX; i++)
+    {
+      failures[i] = 0;
+      connectMs[i] = 0;
+      retryAt[i] = 0;
+    }
+  }
+
+  bool ready(uint8_t broker, uint32_t nowMs) const
+  {
+    return failures[broker] == 0 || (int32_t)(nowMs - retryAt[broker]) >= 0;
+  }
+
+  // Healthiest broker that may be tried now, other than exclude; -1 if none
+  int pick(uint32_t nowMs, int exclude) const
+  {
+    int best = -1;
+    for(uint8_t i = 0; i < count; i++)
+    {
+      if(i == exclude || !ready(i, nowMs))
+      {
+        continue;
+      }
+      if(best < 0 || failures[i] < failures[best] ||
+         (failures[i] == failures[best] && connectMs[i] < connectMs[best]))
+      {
+        best = i;
+      }
+    }
+    return best;
+  }
+
+  void onConnect(uint8_t broker, bool ok, uint32_t elapsedMs, uint32_t nowMs)
+  {
+    if(ok)
+    {
+      failures[broker] = 0;
+      connectMs[broker] = connectMs[broker] ? connectMs[broker] - connectMs[broker] / 4 + elapsedMs / 4
+                                            : elapsedMs;
+      return;
+    }
+    if(failures[broker] < 31)
+    {
+      failures[broker]++;
+    }
+    uint32_t delay = backoffMs;
+    for(uint8_t i = 1; i < failures[broker] && delay < maxBackoffMs; i++)
+    {
+      delay *= 2;
+    }
+    retryAt[broker] = nowMs + (delay < maxBackoffMs ? delay : maxBackoffMs);
+  }
+
+  // A session that was up and dropped ranks the broker below healthy ones
+  // but leaves it free to be retried at once
+  void onDrop(uint8_t broker, uint32_t nowMs)
+  {
+    if(failures[broker] < 31)
+    {
+      failures[broker]++;
+    }
+    retryAt[broker] = nowMs;
+  }
+};
+
+#endif // __BROKER_SELECTOR_H__
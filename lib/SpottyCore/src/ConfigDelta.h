@@ -0,0 +1,74 @@
+#ifndef __CONFIG_DELTA_H__
+#define __CONFIG_DELTA_H__
+
+#include <stdint.h>
+
+#define CONFIG_DELTA_MAX_ENTRIES 16
+
+enum ConfigDeltaType
+{
+  CONFIG_DELTA_APPLY = 1,
+  CONFIG_DELTA_ROLLBACK = 2
+};
+
+struct ConfigDeltaEntry
+{
+  uint8_t key;
+  uint32_t value;
+};
+
+/*
+* Binary config delta pushed by the gateway, all integers big-endian:
+*
+*   apply:    [1][base u16][version u16][n u8] n * ([key u8][value u32])
+*   rollback: [2][version u16]
+*
+* An apply delta only takes effect on a node currently at base, so deltas
+* can be pushed in waves without a node skipping one. A rollback names the
+* version the node must be at to be rolled back.
+*/
+struct ConfigDelta
+{
+  uint8_t type;
+  uint16_t baseVersion;
+  uint16_t version;
+  uint8_t count;
+  ConfigDeltaEntry entries[CONFIG_DELTA_MAX_ENTRIES];
+
+  bool parse(const uint8_t* data, uint32_t length)
+  {
+    if(length < 3)
+    {
+      return false;
+    }
+    type = data[0];
+    if(type == CONFIG_DELTA_ROLLBACK)
+    {
+      version = (uint16_t)((data[1] << 8) | data[2]);
+      baseVersion = version;
+      count = 0;
+      return length == 3;
+    }
+    if(type != CONFIG_DELTA_APPLY || length < 6)
+    {
+      return false;
+    }
+    baseVersion = (uint16_t)((data[1] << 8) | data[2]);
+    version = (uint16_t)((data[3] << 8) | data[4]);
+    count = data[5];
+    if(count > CONFIG_DELTA_MAX_ENTRIES || length != 6 + (uint32_t)count * 5)
+    {
+      return false;
+    }
+    const uint8_t* entry = data + 6;
+    for(uint8_t i = 0; i < count; i++, entry += 5)
+    {
+      entries[i].key = entry[0];
+      entries[i].value = ((uint32_t)entry[1] << 24) | ((uint32_t)entry[2] << 16) |
+                         ((uint32_t)entry[3] << 8) | entry[4];
+    }
+    return true;
+  }
+};
+
+#endif // __CONFIG_DELTA_H__
@@ -0,0 +1,58 @@
+#ifndef __CYCLE_HISTOGRAM_H__
+#define __CYCLE_HISTOGRAM_H__
+
+#include <stdint.h>
+#include "IsrSafe.h"
+
+#define CYCLE_HISTOGRAM_BUCKETS 8
+
+/*
+* Log2 histogram of CPU cycle counts, cheap enough to update from an ISR:
+* bucket 0 counts samples under one unit of 2^unitShift cycles, bucket i
+* those in [2^(i-1), 2^i) units, and the last bucket everything above.
+* Uses shifts only, since the target has no hardware divide.
+*/
+struct CycleHistogram
+{
+  volatile uint32_t buckets[CYCLE_HISTOGRAM_BUCKETS];
+  volatile uint32_t maxCycles;
+  uint8_t unitShift;
+
+  void begin(uint8_t shift)
+  {
+    for(uint8_t i = 0; i < CYCLE_HISTOGRAM_BUCKETS; i++)
+    {
+      buckets[i] = 0;
+    }
+    maxCycles = 0;
+    unitShift = shift;
+  }
+
+  SPOTTY_ISR_INLINE void record(uint32_t cycles)
+  {
+    uint32_t units = cycles >> unitShift;
+    uint8_t bucket = 0;
+    while(units && bucket < CYCLE_HISTOGRAM_BUCKETS - 1)
+    {
+      units >>= 1;
+      bucket++;
+    }
+    buckets[bucket] = buckets[bucket] + 1;
+    if(cycles > maxCycles)
+    {
+      maxCycles = cycles;
+    }
+  }
+
+  uint32_t samples() const
+  {
+    uint32_t total = 0;
+    for(uint8_t i = 0; i < CYCLE_HISTOGRAM_BUCKETS; i++)
+    {
+      total += buckets[i];
+    }
+    return total;
+  }
+};
+
+#endif // __CYCLE_HISTOGRAM_H__
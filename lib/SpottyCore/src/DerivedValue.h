@@ -0,0 +1,104 @@
+#ifndef __DERIVED_VALUE_H__
+#define __DERIVED_VALUE_H__
+
+#include <stdint.h>
+
+#define DERIVED_MAX_DEPENDENTS 4
+#define DERIVED_FOREVER 0xffffffff
+
+// Computes a node's value. validMs starts at DERIVED_FOREVER; values that
+// also depend on the clock shorten it to how long the result holds.
+typedef int32_t (*DeriveFunction)(uint32_t nowMs, uint32_t& validMs);
+
+/*
+* Node in a small graph of lazily evaluated values. An input change
+* invalidate()s the node it feeds, which marks everything downstream dirty;
+* a node is recomputed only when it is read while dirty or past its
+* validity. A compute function reads its inputs with get(nowMs, validMs),
+* so a dependent expires no later than the inputs it was built from.
+*/
+struct DerivedValue
+{
+  DeriveFunction compute;
+  int32_t value;
+  bool dirty;
+  uint32_t computedAt;
+  uint32_t validMs;
+  DerivedValue* dependents[DERIVED_MAX_DEPENDENTS];
+  uint8_t dependentCount;
+  uint32_t reads;
+  uint32_t evaluations;
+
+  void begin(DeriveFunction function)
+  {
+    compute = function;
+    value = 0;
+    dirty = true;
+    computedAt = 0;
+    validMs = DERIVED_FOREVER;
+    dependentCount = 0;
+    reads = 0;
+    evaluations = 0;
+  }
+
+  bool dependsOn(DerivedValue& input)
+  {
+    if(input.dependentCount == DERIVED_MAX_DEPENDENTS)
+    {
+      return false;
+    }
+    input.dependents[input.dependentCount++] = this;
+    return true;
+  }
+
+  // A dirty node's dependents are dirty already, so propagation stops there
+  void invalidate()
+  {
+    if(dirty)
+    {
+      return;
+    }
+    dirty = true;
+    for(uint8_t i = 0; i < dependentCount; i++)
+    {
+      dependents[i]->invalidate();
+    }
+  }
+
+  bool expired(uint32_t nowMs) const
+  {
+    return dirty || (validMs != DERIVED_FOREVER && nowMs - computedAt >= validMs);
+  }
+
+  int32_t get(uint32_t nowMs)
+  {
+    reads++;
+    if(expired(nowMs))
+    {
+      uint32_t valid = DERIVED_FOREVER;
+      value = compute(nowMs, valid);
+      validMs = valid;
+      computedAt = nowMs;
+      dirty = false;
+      evaluations++;
+    }
+    return value;
+  }
+
+  // Read as the input of another node, carrying this node's remaining validity into it
+  int32_t get(uint32_t nowMs, uint32_t& dependentValidMs)
+  {
+    int32_t result = get(nowMs);
+    if(validMs != DERIVED_FOREVER)
+    {
+      uint32_t remaining = validMs - (nowMs - computedAt);
+      if(remaining < dependentValidMs)
+      {
+        dependentValidMs = remaining;
+      }
+    }
+    return result;
+  }
+};
+
+#endif // __DERIVED_VALUE_H__
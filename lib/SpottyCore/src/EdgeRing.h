@@ -0,0 +1,63 @@
+#ifndef __EDGE_RING_H__
+#define __EDGE_RING_H__
+
+#include <stdint.h>
+#include "IsrSafe.h"
+
+#define EDGE_RING_SIZE 32
+
+struct EdgeEvent
+{
+  uint32_t ms;
+  // Pulse width for falling edges, 0 for rising ones
+  uint32_t widthMs;
+  uint8_t zone;
+  uint8_t level;
+};
+
+/*
+* Single producer (ISR), single consumer (loop) ring of input edges. Only
+* the producer writes head and only the consumer writes tail, so neither
+* side needs to disable interrupts; a compiler barrier keeps the event
+* write ahead of the head update on the single-core target. A full ring
+* drops the new edge and counts it.
+*/
+struct EdgeRing
+{
+  EdgeEvent events[EDGE_RING_SIZE];
+  volatile uint8_t head;
+  volatile uint8_t tail;
+  volatile uint32_t overflows;
+
+  SPOTTY_ISR_INLINE bool push(uint32_t ms, uint32_t widthMs, uint8_t zone, uint8_t level)
+  {
+    uint8_t next = (uint8_t)((head + 1) % EDGE_RING_SIZE);
+    if(next == tail)
+    {
+      overflows = overflows + 1;
+      return false;
+    }
+    EdgeEvent& event = events[head];
+    event.ms = ms;
+    event.widthMs = widthMs;
+    event.zone = zone;
+    event.level = level;
+    __asm__ __volatile__("" ::: "memory");
+    head = next;
+    return true;
+  }
+
+  bool pop(EdgeEvent& event)
+  {
+    if(tail == head)
+    {
+      return false;
+    }
+    __asm__ __volatile__("" ::: "memory");
+    event = events[tail];
+    tail = (uint8_t)((tail + 1) % EDGE_RING_SIZE);
+    return true;
+  }
+};
+
+#endif // __EDGE_RING_H__
@@ -0,0 +1,115 @@
+#ifndef __FLOW_ESTIMATOR_H__
+#define __FLOW_ESTIMATOR_H__
+
+#include <stdint.h>
+
+#define FLOW_MAX_SOURCES 4
+#define FLOW_BUCKETS 24
+
+/*
+* Estimates how often motion at an adjacent room (a corridor, an entrance)
+* is followed by an arrival here within windowMs. Counts are kept in a ring
+* of FLOW_BUCKETS time buckets per source, so memory is fixed and old
+* behaviour ages out after FLOW_BUCKETS * bucketMs.
+*/
+struct FlowEstimator
+{
+  uint32_t windowMs;
+  uint32_t bucketMs;
+  uint32_t bucketStart;
+  uint8_t bucket;
+  uint16_t upstream[FLOW_MAX_SOURCES][FLOW_BUCKETS];
+  uint16_t converted[FLOW_MAX_SOURCES][FLOW_BUCKETS];
+  uint32_t lastUpstream[FLOW_MAX_SOURCES];
+  bool pending[FLOW_MAX_SOURCES];
+
+  void begin(uint32_t window, uint32_t bucketLength, uint32_t nowMs)
+  {
+    windowMs = window;
+    bucketMs = bucketLength;
+    bucketStart = nowMs;
+    bucket = 0;
+    for(uint8_t s = 0; s < FLOW_MAX_SOURCES; s++)
+    {
+      for(uint8_t b = 0; b < FLOW_BUCKETS; b++)
+      {
+        upstream[s][b] = 0;
+        converted[s][b] = 0;
+      }
+      lastUpstream[s] = 0;
+      pending[s] = false;
+    }
+  }
+
+  void tick(uint32_t nowMs)
+  {
+    while(nowMs - bucketStart >= bucketMs)
+    {
+      bucketStart += bucketMs;
+      bucket = (bucket + 1) % FLOW_BUCKETS;
+      for(uint8_t s = 0; s < FLOW_MAX_SOURCES; s++)
+      {
+        upstream[s][bucket] = 0;
+        converted[s][bucket] = 0;
+      }
+    }
+    for(uint8_t s = 0; s < FLOW_MAX_SOURCES; s++)
+    {
+      if(pending[s] && nowMs - lastUpstream[s] > windowMs)
+      {
+        pending[s] = false;
+      }
+    }
+  }
+
+  /*
+  * Motion at an adjacent source. Returns the share of past events from it
+  * that led to an arrival here, in percent, or -1 below minSamples.
+  */
+  int onUpstream(uint8_t source, uint32_t nowMs, uint16_t minSamples)
+  {
+    tick(nowMs);
+    // Repeated corridor edges within the window are one passer-by
+    if(!pending[source])
+    {
+      if(upstream[source][bucket] < 0xffff)
+      {
+        upstream[source][bucket]++;
+      }
+      pending[source] = true;
+    }
+    lastUpstream[source] = nowMs;
+
+    uint32_t seen = 0;
+    uint32_t arrived = 0;
+    for(uint8_t b = 0; b < FLOW_BUCKETS; b++)
+    {
+      seen += upstream[source][b];
+      arrived += converted[source][b];
+    }
+    if(seen < minSamples)
+    {
+      return -1;
+    }
+    return (int)(arrived * 100 / seen);
+  }
+
+  // An arrival here credits every source that fired within the window
+  void onLocalArrival(uint32_t nowMs)
+  {
+    tick(nowMs);
+    for(uint8_t s = 0; s < FLOW_MAX_SOURCES; s++)
+    {
+      if(pending[s])
+      {
+        pending[s] = false;
+        if(converted[s][bucket] < 0xffff)
+        {
+          converted[s][bucket]++;
+        }
+      }
+    }
+  }
+};
+
+#endif // __FLOW_ESTIMATOR_H__
@@ -0,0 +1,79 @@
+#ifndef __HISTORY_COLUMNS_H__
+#define __HISTORY_COLUMNS_H__
+
+#include <stdint.h>
+
+/*
+* Columnar layout of the hourly history file. After a 12 byte header
+*
+*   ["SPH1"][slots u16][head u16][reserved u32]
+*
+* each column is stored contiguously as slots little-endian values, so a
+* reader can stream or map one column without touching the others. Slot
+* head is the next one to be written; slots with hour 0 are empty.
+*/
+enum HistoryColumn
+{
+  HISTORY_HOUR,
+  HISTORY_OCCUPIED_SECONDS,
+  HISTORY_ENTRIES,
+  HISTORY_EDGES,
+  HISTORY_PEAK_COUNT,
+  HISTORY_COLUMNS
+};
+
+#define HISTORY_HEADER_SIZE 12
+
+static const uint8_t historyColumnWidth[HISTORY_COLUMNS] = {4, 2, 2, 2, 1};
+
+inline uint32_t historyColumnOffset(uint8_t column, uint16_t slots)
+{
+  uint32_t offset = HISTORY_HEADER_SIZE;
+  for(uint8_t c = 0; c < column; c++)
+  {
+    offset += (uint32_t)historyColumnWidth[c] * slots;
+  }
+  return offset;
+}
+
+inline uint32_t historyFileSize(uint16_t slots)
+{
+  return historyColumnOffset(HISTORY_COLUMNS, slots);
+}
+
+/*
+* On flash the node appends one row per hour, the columns of a slot side
+* by side in column order, and transposes rows into the columnar layout
+* only when exporting.
+*/
+#define HISTORY_ROW_SIZE 11
+
+inline uint8_t historyRowOffset(uint8_t column)
+{
+  uint8_t offset = 0;
+  for(uint8_t c = 0; c < column; c++)
+  {
+    offset += historyColumnWidth[c];
+  }
+  return offset;
+}
+
+inline void historyPack(uint8_t* out, uint32_t value, uint8_t width)
+{
+  for(uint8_t i = 0; i < width; i++)
+  {
+    out[i] = (uint8_t)(value >> (8 * i));
+  }
+}
+
+inline uint32_t historyUnpack(const uint8_t* in, uint8_t width)
+{
+  uint32_t value = 0;
+  for(uint8_t i = 0; i < width; i++)
+  {
+    value |= (uint32_t)in[i] << (8 * i);
+  }
+  return value;
+}
+
+#endif // __HISTORY_COLUMNS_H__
@@ -0,0 +1,144 @@
+#ifndef __IO_LOG_H__
+#define __IO_LOG_H__
+
+#include <stdint.h>
+
+enum IoRecordType
+{
+  IO_BOOT = 1,
+  IO_MOTION,
+  IO_PIN_LEVEL,
+  IO_WIFI_STATUS,
+  IO_MQTT_CONNECT,
+  IO_MQTT_MESSAGE,
+  IO_PUBLISH_RESULT,
+  IO_CLOCK,
+  // Same clock as before, written absolute; starts a rotated log file
+  IO_SYNC,
+  // One sensor edge: [ISR ms u32][pulse width ms u32][zone u8][level u8]
+  IO_EDGE
+};
+
+struct IoRecord
+{
+  uint8_t type;
+  uint32_t ms;
+  uint8_t length;
+  const uint8_t* data;
+};
+
+/*
+* Compact log of external inputs. Each record is
+*
+*   [type u8][ms since previous record, LEB128][length u8][data]
+*
+* and an IO_BOOT record restarts the clock, so logs from several boots can
+* be appended to one file and still be replayed in order. IO_BOOT and
+* IO_SYNC carry absolute milliseconds instead of a delta, so a file that
+* starts with either can be read on its own.
+*/
+struct IoLogWriter
+{
+  uint8_t* buffer;
+  uint32_t capacity;
+  uint32_t used;
+  uint32_t lastMs;
+
+  void begin(uint8_t* storage, uint32_t size)
+  {
+    buffer = storage;
+    capacity = size;
+    used = 0;
+    lastMs = 0;
+  }
+
+  // False when the record does not fit; flush and append again
+  bool append(uint8_t type, uint32_t ms, const uint8_t* data, uint8_t length)
+  {
+    uint32_t delta = (type == IO_BOOT || type == IO_SYNC) ? ms : ms - lastMs;
+    uint8_t varint[5];
+    uint8_t varintLength = 0;
+    do
+    {
+      uint8_t bits = delta & 0x7f;
+      delta >>= 7;
+      varint[varintLength++] = bits | (delta ? 0x80 : 0);
+    } while(delta);
+
+    if(used + 2 + varintLength + length > capacity)
+    {
+      return false;
+    }
+    buffer[used++] = type;
+    for(uint8_t i = 0; i < varintLength; i++)
+    {
+      buffer[used++] = varint[i];
+    }
+    buffer[used++] = length;
+    for(uint8_t i = 0; i < length; i++)
+    {
+      buffer[used++] = data[i];
+    }
+    lastMs = ms;
+    return true;
+  }
+};
+
+struct IoLogReader
+{
+  const uint8_t* data;
+  uint32_t length;
+  uint32_t position;
+  uint32_t ms;
+
+  void begin(const uint8_t* log, uint32_t size)
+  {
+    data = log;
+    length = size;
+    position = 0;
+    ms = 0;
+  }
+
+  // False at the end of the log or on a truncated record
+  bool next(IoRecord& record)
+  {
+    if(position >= length)
+    {
+      return false;
+    }
+    record.type = data[position++];
+
+    uint32_t delta = 0;
+    for(uint8_t shift = 0; ; shift += 7)
+    {
+      if(position >= length || shift > 28)
+      {
+        return false;
+      }
+      uint8_t bits = data[position++];
+      delta |= (uint32_t)(bits & 0x7f) << shift;
+      if(!(bits & 0x80))
+      {
+        break;
+      }
+    }
+
+    if(position >= length)
+    {
+      return false;
+    }
+    record.length = data[position++];
+    if(length - position < record.length)
+    {
+      return false;
+    }
+    record.data = data + position;
+    position += record.length;
+
+    ms = (record.type == IO_BOOT || record.type == IO_SYNC) ? delta : ms + delta;
+    record.ms = ms;
+    return true;
+  }
+};
+
+#endif // __IO_LOG_H__
@@ -0,0 +1,14 @@
+#ifndef __ISR_SAFE_H__
+#define __ISR_SAFE_H__
+
+/*
+* Members called from interrupt handlers. Header functions are emitted to
+* flash when the compiler chooses not to inline them, where an ISR would
+* stall on a cache miss or crash during a flash write; forcing them inline
+* keeps their code in the calling handler's IRAM section.
+*/
+#ifndef SPOTTY_ISR_INLINE
+#define SPOTTY_ISR_INLINE inline __attribute__((always_inline))
+#endif
+
+#endif // __ISR_SAFE_H__
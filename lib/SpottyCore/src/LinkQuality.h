@@ -0,0 +1,78 @@
+#ifndef __LINK_QUALITY_H__
+#define __LINK_QUALITY_H__
+
+#include <stdint.h>
+
+enum LinkGrade
+{
+  LINK_GOOD,
+  LINK_DEGRADED,
+  LINK_POOR
+};
+
+struct LinkThresholds
+{
+  int32_t degradedRssi;
+  int32_t poorRssi;
+  uint32_t degradedRttUs;
+  uint32_t poorRttUs;
+};
+
+/*
+* Link quality estimate from RSSI, publish round trip time and recent
+* failures. The time a blocking publish takes stands in for the ACK RTT,
+* since lwIP does not expose it to the application.
+*/
+struct LinkQuality
+{
+  LinkThresholds thresholds;
+  int32_t rssi;
+  // EWMA of publish time, weight 1/8
+  uint32_t rttUs;
+  // Decaying failure score, 256 per failure, 3/4 kept per publish
+  uint32_t failureScore;
+  uint32_t failures;
+
+  void begin(const LinkThresholds& limits)
+  {
+    thresholds = limits;
+    rssi = 0;
+    rttUs = 0;
+    failureScore = 0;
+    failures = 0;
+  }
+
+  void onPublish(uint32_t latencyUs, bool ok, int32_t rssiNow)
+  {
+    rssi = rssiNow;
+    if(rttUs == 0)
+    {
+      rttUs = latencyUs;
+    }
+    else
+    {
+      rttUs = rttUs - rttUs / 8 + latencyUs / 8;
+    }
+    failureScore = failureScore * 3 / 4;
+    if(!ok)
+    {
+      failureScore += 256;
+      failures++;
+    }
+  }
+
+  LinkGrade grade() const
+  {
+    if(failureScore > 256 || rssi < thresholds.poorRssi || rttUs > thresholds.poorRttUs)
+    {
+      return LINK_POOR;
+    }
+    if(failureScore > 64 || rssi < thresholds.degradedRssi || rttUs > thresholds.degradedRttUs)
+    {
+      return LINK_DEGRADED;
+    }
+    return LINK_GOOD;
+  }
+};
+
+#endif // __LINK_QUALITY_H__
@@ -0,0 +1,132 @@
+#ifndef __OCCUPANCY_H__
+#define __OCCUPANCY_H__
+
+#include <stdint.h>
+
+enum OccupancyEvent
+{
+  OCCUPANCY_NONE,
+  OCCUPANCY_ENTERED,
+  OCCUPANCY_REFRESHED,
+  OCCUPANCY_VACATED
+};
+
+/*
+* Occupancy state machine for one zone. It is fed the edge counter and
+* trigger time written by the ISR, and reports entered/refreshed/vacated
+* transitions. Edges that arrive between two calls are coalesced.
+* When both edges are captured, onLevel() tracks which sensors hold their
+* output HIGH: the room stays occupied for as long as any does, and the
+* hold time runs from the last falling edge. A sensor HIGH for longer than
+* maxHighMs (a stuck PIR, or an open input pulled up) stops holding the
+* room until it next falls. While suppressed (a faulty sensor) levels are
+* ignored and the room holds from the moment suppression began.
+*/
+#define OCCUPANCY_MAX_SENSORS 8
+
+struct Occupancy
+{
+  uint32_t holdMs;
+  uint32_t maxHighMs;
+  uint32_t lastTrigger;
+  uint32_t handledEdges;
+  uint32_t coalesced;
+  uint32_t highSince[OCCUPANCY_MAX_SENSORS];
+  uint8_t highSensors;
+  uint8_t stuckSensors;
+  bool suppressed;
+  bool occupied;
+
+  // maxHigh of 0 lets a sensor hold the room indefinitely
+  void begin(uint32_t hold, uint32_t maxHigh = 0)
+  {
+    holdMs = hold;
+    maxHighMs = maxHigh;
+    lastTrigger = 0;
+    handledEdges = 0;
+    coalesced = 0;
+    highSensors = 0;
+    stuckSensors = 0;
+    suppressed = false;
+    occupied = false;
+  }
+
+  // Entering suppression counts as every sensor falling at ms; on leaving
+  // it the caller should resync the levels with onLevel()
+  void setSuppressed(bool on, uint32_t ms)
+  {
+    if(on && !suppressed)
+    {
+      highSensors = 0;
+      stuckSensors = 0;
+      if(occupied)
+      {
+        lastTrigger = ms;
+      }
+    }
+    suppressed = on;
+  }
+
+  void onLevel(uint8_t sensor, bool high, uint32_t ms)
+  {
+    if(suppressed)
+    {
+      return;
+    }
+    uint8_t bit = (uint8_t)(1 << sensor);
+    if(high)
+    {
+      // Repeated HIGH reports (a resync) keep the original start
+      if(!((highSensors | stuckSensors) & bit))
+      {
+        highSensors |= bit;
+        highSince[sensor] = ms;
+      }
+      return;
+    }
+    highSensors &= (uint8_t)~bit;
+    stuckSensors &= (uint8_t)~bit;
+    if(occupied)
+    {
+      lastTrigger = ms;
+    }
+  }
+
+  OccupancyEvent onMotion(uint32_t triggerMs, uint32_t edges)
+  {
+    if(edges - handledEdges > 1)
+    {
+      coalesced += edges - handledEdges - 1;
+    }
+    handledEdges = edges;
+    lastTrigger = triggerMs;
+
+    if(occupied)
+    {
+      return OCCUPANCY_REFRESHED;
+    }
+    occupied = true;
+    return OCCUPANCY_ENTERED;
+  }
+
+  OccupancyEvent tick(uint32_t nowMs)
+  {
+    for(uint8_t sensor = 0; maxHighMs && sensor < OCCUPANCY_MAX_SENSORS; sensor++)
+    {
+      uint8_t bit = (uint8_t)(1 << sensor);
+      if((highSensors & bit) && nowMs - highSince[sensor] > maxHighMs)
+      {
+        highSensors &= (uint8_t)~bit;
+        stuckSensors |= bit;
+      }
+    }
+    if(occupied && !highSensors && (nowMs - lastTrigger > holdMs))
+    {
+      occupied = false;
+      return OCCUPANCY_VACATED;
+    }
+    return OCCUPANCY_NONE;
+  }
+};
+
+#endif // __OCCUPANCY_H__
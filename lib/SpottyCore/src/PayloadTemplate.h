@@ -0,0 +1,183 @@
+#ifndef __PAYLOAD_TEMPLATE_H__
+#define __PAYLOAD_TEMPLATE_H__
+
+#include <stdint.h>
+#include <string.h>
+
+#define TEMPLATE_MAX_OPS 16
+#define TEMPLATE_TEXT_SIZE 96
+
+enum TemplateOpCode
+{
+  TEMPLATE_LITERAL,
+  TEMPLATE_FIELD,
+  TEMPLATE_CHOICE
+};
+
+// A literal span, a numeric field, or one of two literal spans by field != 0
+struct TemplateOp
+{
+  uint8_t code;
+  uint8_t field;
+  uint8_t offset;
+  uint8_t length;
+  uint8_t altOffset;
+  uint8_t altLength;
+};
+
+/*
+* Payload template compiled once into a short op list. Source text is
+* literal except for ${name}, which renders a numeric field, and
+* ${name?yes:no}, which renders yes when the field is non-zero and no
+* otherwise. Rendering walks the ops with no parsing and no allocation.
+*/
+struct PayloadTemplate
+{
+  char text[TEMPLATE_TEXT_SIZE];
+  TemplateOp ops[TEMPLATE_MAX_OPS];
+  uint8_t opCount;
+  uint8_t textLength;
+
+  bool addOp(uint8_t code, uint8_t field, const char* span, uint32_t length,
+             const char* alt, uint32_t altLength)
+  {
+    if(opCount == TEMPLATE_MAX_OPS || textLength + length + altLength > TEMPLATE_TEXT_SIZE)
+    {
+      return false;
+    }
+    TemplateOp& op = ops[opCount++];
+    op.code = code;
+    op.field = field;
+    op.offset = textLength;
+    op.length = (uint8_t)length;
+    memcpy(text + textLength, span, length);
+    textLength += length;
+    op.altOffset = textLength;
+    op.altLength = (uint8_t)altLength;
+    memcpy(text + textLength, alt, altLength);
+    textLength += altLength;
+    return true;
+  }
+
+  static int findField(const char* name, uint32_t length, const char* const* names, uint8_t nameCount)
+  {
+    for(uint8_t i = 0; i < nameCount; i++)
+    {
+      if(strlen(names[i]) == length && memcmp(names[i], name, length) == 0)
+      {
+        return i;
+      }
+    }
+    return -1;
+  }
+
+  bool compile(const char* source, uint32_t length, const char* const* names, uint8_t nameCount)
+  {
+    opCount = 0;
+    textLength = 0;
+    // Rendered payloads are published as C strings and would be cut short
+    if(memchr(source, '\0', length))
+    {
+      return false;
+    }
+    uint32_t i = 0;
+    while(i < length)
+    {
+      uint32_t start = i;
+      while(i < length && !(source[i] == '$' && i + 1 < length && source[i + 1] == '{'))
+      {
+        i++;
+      }
+      if(i > start && !addOp(TEMPLATE_LITERAL, 0, source + start, i - start, source, 0))
+      {
+        return false;
+      }
+      if(i == length)
+      {
+        break;
+      }
+
+      i += 2;
+      uint32_t nameStart = i;
+      while(i < length && source[i] != '}' && source[i] != '?')
+      {
+        i++;
+      }
+      int field = findField(source + nameStart, i - nameStart, names, nameCount);
+      if(i == length || field < 0)
+      {
+        return false;
+      }
+
+      if(source[i] == '}')
+      {
+        if(!addOp(TEMPLATE_FIELD, field, source, 0, source, 0))
+        {
+          return false;
+        }
+        i++;
+        continue;
+      }
+
+      uint32_t yesStart = ++i;
+      while(i < length && source[i] != ':')
+      {
+        i++;
+      }
+      uint32_t yesEnd = i;
+      uint32_t noStart = ++i;
+      while(i < length && source[i] != '}')
+      {
+        i++;
+      }
+      if(i >= length || !addOp(TEMPLATE_CHOICE, field, source + yesStart, yesEnd - yesStart,
+                               source + noStart, i - noStart))
+      {
+        return false;
+      }
+      i++;
+    }
+    return opCount > 0;
+  }
+
+  // Render into out (NUL terminated); returns the length, or 0 if it did not fit
+  uint32_t render(const uint32_t* values, char* out, uint32_t capacity) const
+  {
+    uint32_t used = 0;
+    for(uint8_t i = 0; i < opCount; i++)
+    {
+      const TemplateOp& op = ops[i];
+      const char* span = text + op.offset;
+      uint32_t length = op.length;
+      char digits[10];
+
+      if(op.code == TEMPLATE_FIELD)
+      {
+        uint32_t value = values[op.field];
+        length = 0;
+        do
+        {
+          digits[sizeof(digits) - 1 - length++] = (char)('0' + value % 10);
+          value /= 10;
+        } while(value);
+        span = digits + sizeof(digits) - length;
+      }
+      else if(op.code == TEMPLATE_CHOICE && values[op.field] == 0)
+      {
+        span = text + op.altOffset;
+        length = op.altLength;
+      }
+
+      if(used + length >= capacity)
+      {
+        return 0;
+      }
+      memcpy(out + used, span, length);
+      used += length;
+    }
+    out[used] = '\0';
+    return used;
+  }
+};
+
+#endif // __PAYLOAD_TEMPLATE_H__
@@ -0,0 +1,136 @@
+#ifndef __PEOPLE_COUNTER_H__
+#define __PEOPLE_COUNTER_H__
+
+#include <stdint.h>
+
+#define PEOPLE_MAX_ZONES 8
+
+/*
+* People count estimate from zone-level PIR occupancy, one zone per stall
+* or area. A zone counts while its sensor is HIGH (fed by onLevel()) and
+* for holdMs after its last trigger or falling edge. Zones whose evidence
+* is older than half the hold may already be empty, which gives the lower
+* bound; the estimate itself is the upper bound.
+* Updated incrementally per event; tick() only scans when a zone is due.
+*/
+struct PeopleCounter
+{
+  uint32_t holdMs;
+  uint32_t lastTrigger[PEOPLE_MAX_ZONES];
+  uint8_t zones;
+  uint8_t active;
+  uint8_t high;
+  uint32_t nextExpiry;
+
+  void begin(uint8_t zoneCount, uint32_t hold)
+  {
+    zones = zoneCount < PEOPLE_MAX_ZONES ? zoneCount : PEOPLE_MAX_ZONES;
+    holdMs = hold;
+    active = 0;
+    high = 0;
+    nextExpiry = 0;
+    for(uint8_t z = 0; z < PEOPLE_MAX_ZONES; z++)
+    {
+      lastTrigger[z] = 0;
+    }
+  }
+
+  // True when the count changed
+  bool onZoneMotion(uint8_t zone, uint32_t ms)
+  {
+    if(zone >= zones)
+    {
+      return false;
+    }
+    uint8_t before = count();
+    if(!active)
+    {
+      nextExpiry = ms + holdMs;
+    }
+    lastTrigger[zone] = ms;
+    active |= (uint8_t)(1 << zone);
+    return count() != before;
+  }
+
+  // Sensor level of a zone; a HIGH zone never expires and the hold runs
+  // from its falling edge. True when the count changed.
+  bool onLevel(uint8_t zone, bool level, uint32_t ms)
+  {
+    if(zone >= zones)
+    {
+      return false;
+    }
+    uint8_t bit = (uint8_t)(1 << zone);
+    if(level)
+    {
+      high |= bit;
+      // A HIGH zone whose rising edge was missed is still occupied
+      return (active & bit) ? false : onZoneMotion(zone, ms);
+    }
+    high &= (uint8_t)~bit;
+    if(active & bit)
+    {
+      lastTrigger[zone] = ms;
+      if((int32_t)(ms + holdMs - nextExpiry) < 0)
+      {
+        nextExpiry = ms + holdMs;
+      }
+    }
+    return false;
+  }
+
+  // True when zones expired and the count dropped
+  bool tick(uint32_t nowMs)
+  {
+    if(!active || (int32_t)(nowMs - nextExpiry) < 0)
+    {
+      return false;
+    }
+    uint8_t before = count();
+    uint32_t soonest = 0xffffffff;
+    for(uint8_t z = 0; z < zones; z++)
+    {
+      if(!(active & (1 << z)))
+      {
+        continue;
+      }
+      // Rechecked a hold from now, or at its falling edge, whichever is first
+      uint32_t age = (high & (1 << z)) ? 0 : nowMs - lastTrigger[z];
+      if(age > holdMs)
+      {
+        active &= (uint8_t)~(1 << z);
+      }
+      else if(holdMs - age < soonest)
+      {
+        soonest = holdMs - age;
+      }
+    }
+    nextExpiry = nowMs + (soonest == 0xffffffff ? 0 : soonest + 1);
+    return count() != before;
+  }
+
+  uint8_t count() const
+  {
+    uint8_t n = 0;
+    for(uint8_t mask = active; mask; mask &= (uint8_t)(mask - 1))
+    {
+      n++;
+    }
+    return n;
+  }
+
+  uint8_t low(uint32_t nowMs) const
+  {
+    uint8_t n = 0;
+    for(uint8_t z = 0; z < zones; z++)
+    {
+      if((active & (1 << z)) && ((high & (1 << z)) || nowMs - lastTrigger[z] <= holdMs / 2))
+      {
+        n++;
+      }
+    }
+    return (n == 0 && active) ? 1 : n;
+  }
+};
+
+#endif // __PEOPLE_COUNTER_H__
@@ -0,0 +1,102 @@
+#ifndef __POWER_MODEL_H__
+#define __POWER_MODEL_H__
+
+#include <stdint.h>
+
+// Radio states the node moves through; the CPU runs in all of them
+enum PowerPhase
+{
+  PHASE_TX,
+  PHASE_CONNECT,
+  PHASE_LISTEN,
+  PHASE_MODEM_SLEEP,
+  PHASE_LIGHT_SLEEP,
+  POWER_PHASES
+};
+
+/*
+* Time spent in each power phase, in microseconds. The caller reports
+* every phase change and should also call enter() with the current phase
+* regularly, so one delta never spans a micros() wrap.
+*/
+struct PhaseTimer
+{
+  uint64_t totalUs[POWER_PHASES];
+  uint8_t phase;
+  uint32_t since;
+
+  void begin(PowerPhase initial, uint32_t nowUs)
+  {
+    for(uint8_t i = 0; i < POWER_PHASES; i++)
+    {
+      totalUs[i] = 0;
+    }
+    phase = initial;
+    since = nowUs;
+  }
+
+  void enter(PowerPhase next, uint32_t nowUs)
+  {
+    totalUs[phase] += nowUs - since;
+    since = nowUs;
+    phase = next;
+  }
+
+  uint64_t elapsedUs() const
+  {
+    uint64_t total = 0;
+    for(uint8_t i = 0; i < POWER_PHASES; i++)
+    {
+      total += totalUs[i];
+    }
+    return total;
+  }
+};
+
+/*
+* Average supply current per phase. The same model prices phase times
+* counted on a node and phase times replayed from a motion trace, so
+* power configurations can be compared on either.
+*/
+struct PowerModel
+{
+  uint32_t currentUa[POWER_PHASES];
+
+  // Charge drawn, in microamp milliseconds
+  uint64_t chargeUaMs(const PhaseTimer& timer) const
+  {
+    uint64_t total = 0;
+    for(uint8_t i = 0; i < POWER_PHASES; i++)
+    {
+      total += timer.totalUs[i] / 1000 * currentUa[i];
+    }
+    return total;
+  }
+
+  uint32_t chargeUah(const PhaseTimer& timer) const
+  {
+    return (uint32_t)(chargeUaMs(timer) / 3600000ULL);
+  }
+
+  // Hours a battery of capacityMah lasts when the node wakes wakesPerDay
+  // times, each wake drawing uaMsPerWake, and draws sleepUa in between
+  static uint32_t batteryLifeHours(uint32_t capacityMah, uint32_t wakesPerDay,
+                                   uint32_t uaMsPerWake, uint32_t sleepUa)
+  {
+    uint64_t perDayUaMs = (uint64_t)wakesPerDay * uaMsPerWake + (uint64_t)sleepUa * 86400000ULL;
+    if(perDayUaMs == 0)
+    {
+      return 0xffffffff;
+    }
+    return (uint32_t)((uint64_t)capacityMah * 1000ULL * 3600000ULL * 24ULL / perDayUaMs);
+  }
+
+  // Mean current over everything counted so far
+  uint32_t averageUa(const PhaseTimer& timer) const
+  {
+    uint64_t elapsedMs = timer.elapsedUs() / 1000;
+    return elapsedMs ? (uint32_t)(chargeUaMs(timer) / elapsedMs) : 0;
+  }
+};
+
+#endif // __POWER_MODEL_H__
@@ -0,0 +1,130 @@
+#ifndef __SCHEDULE_H__
+#define __SCHEDULE_H__
+
+#include <stdint.h>
+
+#define SCHEDULE_MAX_ENTRIES 8
+
+struct ScheduleEntry
+{
+  uint16_t minuteOfDay;
+  uint8_t profile;
+};
+
+/*
+* Daily profile table. Each entry switches to a profile at a time of day and
+* stays in force until the next entry, wrapping around midnight. Callers ask
+* for the time until the next switch once and sleep on it, so nothing is
+* evaluated per loop.
+*/
+struct Schedule
+{
+  ScheduleEntry entries[SCHEDULE_MAX_ENTRIES];
+  uint8_t count;
+
+  // Profile in force at the given second of the day
+  uint8_t profileAt(uint32_t secondOfDay) const
+  {
+    if(count == 0)
+    {
+      return 0;
+    }
+    uint32_t minute = secondOfDay / 60;
+    uint8_t profile = entries[count - 1].profile;
+    for(uint8_t i = 0; i < count && entries[i].minuteOfDay <= minute; i++)
+    {
+      profile = entries[i].profile;
+    }
+    return profile;
+  }
+
+  // Seconds from secondOfDay until the next entry takes effect
+  uint32_t secondsUntilNext(uint32_t secondOfDay) const
+  {
+    if(count == 0)
+    {
+      return 86400 - secondOfDay;
+    }
+    for(uint8_t i = 0; i < count; i++)
+    {
+      uint32_t start = (uint32_t)entries[i].minuteOfDay * 60;
+      if(start > secondOfDay)
+      {
+        return start - secondOfDay;
+      }
+    }
+    return 86400 - secondOfDay + (uint32_t)entries[0].minuteOfDay * 60;
+  }
+
+  /*
+  * Parse "HH:MM=p,HH:MM=p,..." into a sorted table. The table is left
+  * untouched unless the whole input is valid.
+  */
+  bool parse(const uint8_t* text, uint32_t length, uint8_t profiles)
+  {
+    ScheduleEntry parsed[SCHEDULE_MAX_ENTRIES];
+    uint8_t parsedCount = 0;
+    uint32_t i = 0;
+
+    while(i < length)
+    {
+      uint32_t fields[3] = {0, 0, 0};
+      const char separators[3] = {':', '=', ','};
+      for(int f = 0; f < 3; f++)
+      {
+        uint32_t digits = 0;
+        while(i < length && text[i] >= '0' && text[i] <= '9' && digits < 4)
+        {
+          fields[f] = fields[f] * 10 + (text[i] - '0');
+          digits++;
+          i++;
+        }
+        if(digits == 0)
+        {
+          return false;
+        }
+        if(i < length)
+        {
+          if(text[i] != separators[f])
+          {
+            return false;
+          }
+          i++;
+        }
+        else if(f < 2)
+        {
+          return false;
+        }
+      }
+
+      if(fields[0] > 23 || fields[1] > 59 || fields[2] >= profiles || parsedCount == SCHEDULE_MAX_ENTRIES)
+      {
+        return false;
+      }
+
+      // Insertion sort by time of day
+      ScheduleEntry entry = {(uint16_t)(fields[0] * 60 + fields[1]), (uint8_t)fields[2]};
+      uint8_t at = parsedCount;
+      while(at > 0 && parsed[at - 1].minuteOfDay > entry.minuteOfDay)
+      {
+        parsed[at] = parsed[at - 1];
+        at--;
+      }
+      parsed[at] = entry;
+      parsedCount++;
+    }
+
+    if(parsedCount == 0)
+    {
+      return false;
+    }
+    for(uint8_t e = 0; e < parsedCount; e++)
+    {
+      entries[e] = parsed[e];
+    }
+    count = parsedCount;
+    return true;
+  }
+};
+
+#endif // __SCHEDULE_H__
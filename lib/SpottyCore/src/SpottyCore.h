@@ -0,0 +1,33 @@
+#ifndef __SPOTTY_CORE_H__
+#define __SPOTTY_CORE_H__
+
+/*
+* Hot-path logic shared by the firmware and host-side code. Everything here
+* is header-only, uses fixed-size storage and no exceptions, and needs only
+* <stdint.h>, <string.h> and a GCC-compatible compiler: IsrSafe.h uses
+* __attribute__((always_inline)) and EdgeRing.h uses an asm compiler
+* barrier. It builds unchanged for the ESP8266 and for the host, where
+* test/native runs it (pio test -e native).
+*/
+
+#include "Occupancy.h"
+#include "TokenBucket.h"
+#include "TopicMatch.h"
+#include "TopicRouter.h"
+#include "AnomalyDetector.h"
+#include "LinkQuality.h"
+#include "Schedule.h"
+#include "ConfigDelta.h"
+#include "IoLog.h"
+#include "FlowEstimator.h"
+#include "PeopleCounter.h"
+#include "StateCodec.h"
+#include "EdgeRing.h"
+#include "HistoryColumns.h"
+#include "PayloadTemplate.h"
+#include "BrokerSelector.h"
+#include "CycleHistogram.h"
+#include "DerivedValue.h"
+#include "PowerModel.h"
+
+#endif // __SPOTTY_CORE_H__
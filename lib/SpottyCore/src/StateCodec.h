@@ -0,0 +1,235 @@
+#ifndef __STATE_CODEC_H__
+#define __STATE_CODEC_H__
+
+#include <stdint.h>
+
+#define STATE_MAX_FIELDS 16
+
+enum StateFrameType
+{
+  STATE_KEYFRAME = 1,
+  STATE_DELTA = 2
+};
+
+struct BitWriter
+{
+  uint8_t* out;
+  uint32_t capacity;
+  uint32_t bits;
+
+  void begin(uint8_t* buffer, uint32_t size)
+  {
+    out = buffer;
+    capacity = size;
+    bits = 0;
+  }
+
+  bool put(uint32_t value, uint8_t count)
+  {
+    if(bits + count > capacity * 8)
+    {
+      return false;
+    }
+    while(count--)
+    {
+      uint32_t byteIndex = bits / 8;
+      uint8_t mask = (uint8_t)(0x80 >> (bits % 8));
+      if(bits % 8 == 0)
+      {
+        out[byteIndex] = 0;
+      }
+      if((value >> count) & 1)
+      {
+        out[byteIndex] |= mask;
+      }
+      bits++;
+    }
+    return true;
+  }
+
+  // Nibble varint: 4 value bits plus a continuation bit per group, high group first
+  bool putVarint(uint32_t value)
+  {
+    uint8_t groups = 1;
+    while(groups < 8 && (value >> (groups * 4)))
+    {
+      groups++;
+    }
+    while(groups--)
+    {
+      if(!put(((groups ? 1u : 0u) << 4) | ((value >> (groups * 4)) & 0xf), 5))
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  uint32_t bytes() const
+  {
+    return (bits + 7) / 8;
+  }
+};
+
+struct BitReader
+{
+  const uint8_t* in;
+  uint32_t length;
+  uint32_t bits;
+
+  void begin(const uint8_t* data, uint32_t size)
+  {
+    in = data;
+    length = size;
+    bits = 0;
+  }
+
+  bool get(uint32_t& value, uint8_t count)
+  {
+    if(bits + count > length * 8)
+    {
+      return false;
+    }
+    value = 0;
+    while(count--)
+    {
+      value = (value << 1) | ((in[bits / 8] >> (7 - bits % 8)) & 1);
+      bits++;
+    }
+    return true;
+  }
+
+  bool getVarint(uint32_t& value)
+  {
+    value = 0;
+    for(uint8_t groups = 0; groups < 8; groups++)
+    {
+      uint32_t group;
+      if(!get(group, 5))
+      {
+        return false;
+      }
+      value = (value << 4) | (group & 0xf);
+      if(!(group & 0x10))
+      {
+        return true;
+      }
+    }
+    return false;
+  }
+};
+
+/*
+* Bit-packed state vector frames:
+*
+*   keyframe: [1][seq u16][n u8] then n nibble varints of the values
+*   delta:    [2][seq u16][base u16][n u8] then per field a changed bit,
+*             followed for changed fields by the zigzag nibble varint of
+*             (value - base value)
+*
+* A delta is relative to the state the receiver acknowledged as base, so
+* lost deltas never corrupt the receiver's view.
+*/
+inline uint32_t encodeStateFrame(uint8_t* out, uint32_t capacity, uint16_t seq,
+                                 const uint32_t* base, uint16_t baseSeq,
+                                 const uint32_t* fields, uint8_t count)
+{
+  uint32_t header = base ? 6 : 4;
+  if(count > STATE_MAX_FIELDS || capacity < header)
+  {
+    return 0;
+  }
+  out[0] = base ? STATE_DELTA : STATE_KEYFRAME;
+  out[1] = (uint8_t)(seq >> 8);
+  out[2] = (uint8_t)seq;
+  if(base)
+  {
+    out[3] = (uint8_t)(baseSeq >> 8);
+    out[4] = (uint8_t)baseSeq;
+  }
+  out[header - 1] = count;
+
+  BitWriter writer;
+  writer.begin(out + header, capacity - header);
+  for(uint8_t i = 0; i < count; i++)
+  {
+    if(!base)
+    {
+      if(!writer.putVarint(fields[i]))
+      {
+        return 0;
+      }
+      continue;
+    }
+    int32_t change = (int32_t)(fields[i] - base[i]);
+    if(!writer.put(change != 0, 1))
+    {
+      return 0;
+    }
+    if(change != 0 && !writer.putVarint(((uint32_t)change << 1) ^ (uint32_t)(change >> 31)))
+    {
+      return 0;
+    }
+  }
+  return header + writer.bytes();
+}
+
+/*
+* Decode a frame into fields. Deltas need the receiver's copy of the base
+* state in base (its sequence is returned in baseSeq for the caller to
+* check); keyframes ignore it.
+*/
+inline bool decodeStateFrame(const uint8_t* data, uint32_t length, uint16_t& seq, uint16_t& baseSeq,
+                             const uint32_t* base, uint32_t* fields, uint8_t& count)
+{
+  if(length < 4 || (data[0] != STATE_KEYFRAME && data[0] != STATE_DELTA))
+  {
+    return false;
+  }
+  bool delta = data[0] == STATE_DELTA;
+  uint32_t header = delta ? 6 : 4;
+  if(length < header || (delta && !base))
+  {
+    return false;
+  }
+  seq = (uint16_t)((data[1] << 8) | data[2]);
+  baseSeq = delta ? (uint16_t)((data[3] << 8) | data[4]) : seq;
+  count = data[header - 1];
+  if(count > STATE_MAX_FIELDS)
+  {
+    return false;
+  }
+
+  BitReader reader;
+  reader.begin(data + header, length - header);
+  for(uint8_t i = 0; i < count; i++)
+  {
+    uint32_t value;
+    if(!delta)
+    {
+      if(!reader.getVarint(value))
+      {
+        return false;
+      }
+      fields[i] = value;
+      continue;
+    }
+    uint32_t changed;
+    if(!reader.get(changed, 1))
+    {
+      return false;
+    }
+    fields[i] = base[i];
+    if(changed)
+    {
+      if(!reader.getVarint(value))
+      {
+        return false;
+      }
+      fields[i] += (value >> 1) ^ (uint32_t)-(int32_t)(value & 1);
+    }
+  }
+  return true;
+}
+
+#endif // __STATE_CODEC_H__
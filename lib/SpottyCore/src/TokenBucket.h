@@ -0,0 +1,59 @@
+#ifndef __TOKEN_BUCKET_H__
+#define __TOKEN_BUCKET_H__
+
+#include <stdint.h>
+
+/*
+* Token bucket kept in milli-tokens so refill needs no floating point.
+*/
+struct TokenBucket
+{
+  uint32_t capacity;
+  uint32_t refillMs;
+  uint32_t milliTokens;
+  uint32_t lastRefill;
+
+  void begin(uint32_t size, uint32_t refillPeriodMs, uint32_t nowMs)
+  {
+    capacity = size;
+    refillMs = refillPeriodMs;
+    milliTokens = size * 1000;
+    lastRefill = nowMs;
+  }
+
+  void refill(uint32_t nowMs)
+  {
+    uint32_t full = capacity * 1000;
+    uint32_t elapsed = nowMs - lastRefill;
+    uint64_t added = (uint64_t)elapsed * 1000 / refillMs;
+    if(milliTokens + added >= full)
+    {
+      milliTokens = full;
+      lastRefill = nowMs;
+      return;
+    }
+    milliTokens += (uint32_t)added;
+    // Keep the remainder so slow refill rates are not rounded away
+    lastRefill += (uint32_t)(added * refillMs / 1000);
+  }
+
+  // Take a token if one is available
+  bool take(uint32_t nowMs)
+  {
+    refill(nowMs);
+    if(milliTokens < 1000)
+    {
+      return false;
+    }
+    milliTokens -= 1000;
+    return true;
+  }
+
+  // Always admit, but still drain the bucket so lower priority traffic backs off
+  void force(uint32_t nowMs)
+  {
+    take(nowMs);
+  }
+};
+
+#endif // __TOKEN_BUCKET_H__
@@ -0,0 +1,53 @@
+#ifndef __TOPIC_MATCH_H__
+#define __TOPIC_MATCH_H__
+
+#include <stdint.h>
+
+/*
+* FNV-1a hash of a topic string
+*/
+inline uint32_t topicHash(const char* topic)
+{
+  uint32_t hash = 2166136261u;
+  while(*topic)
+  {
+    hash ^= (uint8_t)*topic++;
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+/*
+* Single pass MQTT filter match supporting '+' and '#', no allocation.
+*/
+inline bool topicMatches(const char* filter, const char* topic)
+{
+  while(*filter)
+  {
+    if(*filter == '#')
+    {
+      return true;
+    }
+    if(*filter == '+')
+    {
+      while(*topic && *topic != '/')
+      {
+        topic++;
+      }
+      filter++;
+    }
+    else
+    {
+      if(*filter != *topic)
+      {
+        // "a/#" also matches the parent level "a"
+        return (*topic == '\0' && filter[0] == '/' && filter[1] == '#' && filter[2] == '\0');
+      }
+      filter++;
+      topic++;
+    }
+  }
+  return *topic == '\0';
+}
+
+#endif // __TOPIC_MATCH_H__
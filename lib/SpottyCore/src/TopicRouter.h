@@ -0,0 +1,97 @@
+#ifndef __TOPIC_ROUTER_H__
+#define __TOPIC_ROUTER_H__
+
+#include <stdint.h>
+#include <string.h>
+#include "TopicMatch.h"
+
+#define TOPIC_CACHE_SIZE 8
+
+typedef void (*TopicHandler)(const char* topic, const uint8_t* payload, unsigned int length);
+
+struct TopicRoute
+{
+  const char* filter;
+  TopicHandler handler;
+};
+
+// Resolved topics are remembered by hash so repeated messages on the same
+// topic skip the route scan and only re-check the one filter they hit.
+struct TopicCacheEntry
+{
+  uint32_t hash;
+  int8_t route;
+};
+
+/*
+* Delivers a message to the first route whose filter matches its topic.
+* Filters may use '+' and '#' and, like the topic, are NUL-terminated
+* strings; filters must outlive the route. The route table is supplied by
+* the caller, so its size is set where the routes are known.
+*/
+struct TopicRouter
+{
+  TopicRoute* routes;
+  uint8_t capacity;
+  uint8_t count;
+  TopicCacheEntry cache[TOPIC_CACHE_SIZE];
+
+  void begin(TopicRoute* storage, uint8_t size)
+  {
+    routes = storage;
+    capacity = size;
+    count = 0;
+    memset(cache, 0, sizeof(cache));
+  }
+
+  // False when the table is full
+  bool add(const char* filter, TopicHandler handler)
+  {
+    if(count >= capacity)
+    {
+      return false;
+    }
+    routes[count].filter = filter;
+    routes[count].handler = handler;
+    count++;
+
+    // Cached resolutions may now be stale
+    memset(cache, 0, sizeof(cache));
+    return true;
+  }
+
+  // False when no route matches the topic
+  bool dispatch(const char* topic, const uint8_t* payload, unsigned int length)
+  {
+    uint32_t hash = topicHash(topic);
+    TopicCacheEntry& entry = cache[hash % TOPIC_CACHE_SIZE];
+
+    int route = -1;
+    if(entry.hash == hash && entry.route > 0 && topicMatches(routes[entry.route - 1].filter, topic))
+    {
+      route = entry.route - 1;
+    }
+    else
+    {
+      for(uint8_t i = 0; i < count; i++)
+      {
+        if(topicMatches(routes[i].filter, topic))
+        {
+          route = i;
+          break;
+        }
+      }
+      if(route < 0)
+      {
+        return false;
+      }
+      entry.hash = hash;
+      entry.route = route + 1;
+    }
+
+    routes[route].handler(topic, payload, length);
+    return true;
+  }
+};
+
+#endif // __TOPIC_ROUTER_H__
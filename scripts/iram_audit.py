@@ -0,0 +1,175 @@
+"""
+IRAM audit for interrupt handlers.
+
+Walks the call graph of the firmware ELF from every ISR entry point and
+fails if anything reachable from one lives outside IRAM or ROM. Code in
+flash runs through the instruction cache; an ISR that misses the cache
+stalls, and one that lands there while flash is being written crashes.
+
+Runs after every PlatformIO link (extra_scripts = post:scripts/iram_audit.py,
+roots listed in custom_isr_roots), or by hand:
+
+    python scripts/iram_audit.py firmware.elf detectsMovement rearmZones \
+        --tool-prefix xtensa-lx106-elf-
+
+Calls are resolved from call0/callN and j targets and from l32r literals
+feeding callxN, which is how -mlongcalls reaches flash from IRAM. A callxN
+through a register that was not loaded from a literal (a function pointer)
+cannot be resolved and is reported as a warning.
+"""
+
+import argparse
+import re
+import struct
+import subprocess
+import sys
+
+IRAM = (0x40100000, 0x4010C000)
+ROM = (0x40000000, 0x40010000)
+
+HEADER = re.compile(r"^([0-9a-f]{8}) <(.+)>:$")
+TARGET = re.compile(r"([0-9a-f]{8})")
+
+
+def in_range(address, bounds):
+    return bounds[0] <= address < bounds[1]
+
+
+def load_sections(path):
+    """Loaded sections of a 32-bit little-endian ELF as (addr, size, bytes)"""
+    with open(path, "rb") as f:
+        data = f.read()
+    if data[:4] != b"\x7fELF" or data[4] != 1 or data[5] != 1:
+        raise ValueError("%s is not a 32-bit little-endian ELF" % path)
+    shoff = struct.unpack_from("<I", data, 0x20)[0]
+    shentsize, shnum = struct.unpack_from("<HH", data, 0x2E)
+    sections = []
+    for i in range(shnum):
+        _, kind, _, addr, offset, size = struct.unpack_from("<IIIIII", data, shoff + i * shentsize)
+        # SHT_PROGBITS only; NOBITS sections have no literals to read
+        if kind == 1 and addr:
+            sections.append((addr, size, data[offset:offset + size]))
+    return sections
+
+
+def read_word(sections, address):
+    for addr, size, body in sections:
+        if addr <= address and address + 4 <= addr + size:
+            return struct.unpack_from("<I", body, address - addr)[0]
+    return None
+
+
+def function_symbols(tool_prefix, elf, environ):
+    """Start address to demangled name for every text symbol"""
+    output = subprocess.check_output([tool_prefix + "nm", "-C", "--defined-only", elf],
+                                     universal_newlines=True, env=environ)
+    names = {}
+    for line in output.splitlines():
+        parts = line.split(" ", 2)
+        if len(parts) == 3 and parts[1] in "TtWw":
+            names.setdefault(int(parts[0], 16), parts[2])
+    return names
+
+
+def call_graph(tool_prefix, elf, sections, names, environ):
+    """Function start address to (callee addresses, unresolved indirect call count)"""
+    output = subprocess.check_output([tool_prefix + "objdump", "-d", "-C", elf],
+                                     universal_newlines=True, env=environ)
+    graph = {}
+    current = None
+    literals = {}
+    for line in output.splitlines():
+        header = HEADER.match(line)
+        if header:
+            current = int(header.group(1), 16)
+            graph.setdefault(current, [set(), 0])
+            literals = {}
+            continue
+        fields = line.split("\t")
+        if current is None or len(fields) < 3:
+            continue
+        mnemonic = fields[2].strip()
+        operands = fields[3].strip() if len(fields) > 3 else ""
+        callees = graph[current][0]
+
+        if mnemonic in ("call0", "call4", "call8", "call12", "j"):
+            target = TARGET.search(operands)
+            if target and int(target.group(1), 16) in names:
+                callees.add(int(target.group(1), 16))
+        elif mnemonic == "l32r":
+            register, _, rest = operands.partition(",")
+            target = TARGET.search(rest)
+            if target:
+                literals[register.strip()] = read_word(sections, int(target.group(1), 16))
+        elif mnemonic in ("callx0", "callx4", "callx8", "callx12"):
+            value = literals.get(operands)
+            if value in names:
+                callees.add(value)
+            else:
+                graph[current][1] += 1
+    return graph
+
+
+def audit(elf, roots, tool_prefix, environ=None):
+    """Print the findings and return the number of violations"""
+    sections = load_sections(elf)
+    names = function_symbols(tool_prefix, elf, environ)
+    graph = call_graph(tool_prefix, elf, sections, names, environ)
+
+    starts = []
+    for root in roots:
+        found = [a for a, n in names.items() if n == root or n.startswith(root + "(")]
+        if not found:
+            print("iram_audit: ISR root %s not found" % root)
+        starts.extend(found)
+
+    violations = 0
+    parent = dict((start, None) for start in starts)
+    queue = list(starts)
+    while queue:
+        function = queue.pop(0)
+        if not (in_range(function, IRAM) or in_range(function, ROM)):
+            path = []
+            step = function
+            while step is not None:
+                path.append(names.get(step, hex(step)))
+                step = parent[step]
+            print("iram_audit: ERROR %s is in flash, reached by %s"
+                  % (names.get(function, hex(function)), " <- ".join(path[1:])))
+            violations += 1
+        callees, indirect = graph.get(function, (set(), 0))
+        if indirect:
+            print("iram_audit: warning: %d indirect call(s) in %s not checked"
+                  % (indirect, names.get(function, hex(function))))
+        for callee in sorted(callees):
+            if callee not in parent:
+                parent[callee] = function
+                queue.append(callee)
+
+    print("iram_audit: %d function(s) reachable from %d ISR root(s), %d outside IRAM"
+          % (len(parent), len(starts), violations))
+    return violations
+
+
+try:
+    Import("env")  # noqa: F821 (PlatformIO SCons)
+except NameError:
+    env = None
+
+if env is not None:
+    def audit_firmware(source, target, env):
+        roots = env.GetProjectOption("custom_isr_roots", "").split()
+        prefix = env.subst("$CC")[:-len("gcc")]
+        # The toolchain is on the build environment's PATH, not necessarily ours
+        if audit(str(target[0]), roots, prefix, env["ENV"]):
+            env.Exit(1)
+
+    env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", audit_firmware)
+
+elif __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Check that ISR-reachable code is in IRAM")
+    parser.add_argument("elf")
+    parser.add_argument("roots", nargs="+", help="ISR entry points, by function name")
+    parser.add_argument("--tool-prefix", default="xtensa-lx106-elf-")
+    args = parser.parse_args()
+    sys.exit(1 if audit(args.elf, args.roots, args.tool_prefix) else 0)
@@ -0,0 +1,138 @@
+#include "constants.h"
+
+static TokenBucket publishBucket;
+static unsigned long lastTelemetry = 0;
+static unsigned long lastRefresh = 0;
+
+#if ISR_TIMING
+// "name=b0/b1/.../b7/maxUs" for one ISR timing histogram; returns the
+// length written, cut to fit
+static int formatHistogram(char* out, size_t size, const char* name, const CycleHistogram& histogram)
+{
+  int length = snprintf(out, size, "%s=", name);
+  for(int i = 0; i < CYCLE_HISTOGRAM_BUCKETS && length < (int)size; i++)
+  {
+    length += snprintf(out + length, size - length, "%lu/", (unsigned long)histogram.buckets[i]);
+  }
+  if(length < (int)size)
+  {
+    length += snprintf(out + length, size - length, "%lu",
+                       (unsigned long)(histogram.maxCycles / (F_CPU / 1000000UL)));
+  }
+  return length < (int)size ? length : (int)size - 1;
+}
+#endif
+
+void beginAdmission()
+{
+  publishBucket.begin(PUBLISH_BUCKET_SIZE, PUBLISH_REFILL_MS, millis());
+  LinkThresholds thresholds = {LINK_DEGRADED_RSSI, LINK_POOR_RSSI, LINK_DEGRADED_RTT_US, LINK_POOR_RTT_US};
+  linkQuality.begin(thresholds);
+  onLinkChanged();
+}
+
+void setRefreshPeriod(unsigned long refreshMs)
+{
+  publishBucket.refill(millis());
+  publishBucket.refillMs = refreshMs;
+}
+
+/*
+* Decide whether an event may be published. Transitions always pass and
+* take a token if one is left; refreshes are shed once the bucket is empty
+* or the link grade says they should wait.
+*/
+bool admitEvent(EventClass eventClass)
+{
+  if(eventClass == EVENT_TRANSITION)
+  {
+    publishBucket.force(millis());
+    metrics.transitions++;
+    return true;
+  }
+
+  LinkGrade grade = linkGrade();
+  if(grade == LINK_POOR ||
+     (grade == LINK_DEGRADED && millis() - lastRefresh < LINK_DEGRADED_REFRESH_MS) ||
+     !publishBucket.take(millis()))
+  {
+    metrics.shed++;
+    return false;
+  }
+  lastRefresh = millis();
+  metrics.refreshes++;
+  return true;
+}
+
+void recordTransitionLatency(unsigned long latencyMs)
+{
+  if(latencyMs > metrics.maxLatencyMs)
+  {
+    metrics.maxLatencyMs = latencyMs;
+  }
+  if(latencyMs > TRANSITION_SLO_MS)
+  {
+    metrics.sloMisses++;
+  }
+}
+
+/*
+* Publish the admission and link counters every telemetryInterval()
+*/
+void reportTelemetry()
+{
+  if(millis() - lastTelemetry < telemetryInterval())
+  {
+    return;
+  }
+  lastTelemetry = millis();
+
+  char message[192];
+  snprintf(message, sizeof(message),
+           "config=%u,transitions=%lu,refreshes=%lu,shed=%lu,coalesced=%lu,maxLatencyMs=%lu,sloMisses=%lu,rejected=%lu,stateBytes=%lu",
+           configVersion, metrics.transitions, metrics.refreshes, metrics.shed,
+           (unsigned long)occupancy.coalesced, metrics.maxLatencyMs, metrics.sloMisses,
+           metrics.rejectedMessages, metrics.stateBytes);
+  publish(telemetry_topic, message, TRAFFIC_BULK);
+
+  snprintf(message, sizeof(message), "pulses=%lu,pulseAvgMs=%lu,pulseMaxMs=%lu,suppressedEdges=%lu,ringOverflows=%lu,renderAvgUs=%lu,renderMaxUs=%lu",
+           metrics.pulses, metrics.pulses ? metrics.totalPulseMs / metrics.pulses : 0UL,
+           metrics.maxPulseMs, room.suppressedEdges, (unsigned long)edgeRing.overflows,
+           metrics.renders ? metrics.totalRenderUs / metrics.renders : 0UL, metrics.maxRenderUs);
+  publish(telemetry_topic, message, TRAFFIC_BULK);
+
+  int length = snprintf(message, sizeof(message), "rssi=%ld,roams=%lu,rttUs=%lu,failures=%lu,grade=%d",
+                        (long)WiFi.RSSI(), linkMetrics.roams, (unsigned long)linkQuality.rttUs,
+                        (unsigned long)linkQuality.failures, (int)linkGrade());
+  for(int band = 0; band < RSSI_BANDS && length < (int)sizeof(message); band++)
+  {
+    unsigned long count = linkMetrics.publishes[band];
+    length += snprintf(message + length, sizeof(message) - length, ",band%d=%lu/%lu/%lu", band, count,
+                       count ? linkMetrics.totalLatencyUs[band] / count : 0UL,
+                       linkMetrics.maxLatencyUs[band]);
+  }
+  publish(telemetry_topic, message, TRAFFIC_BULK);
+
+  snprintf(message, sizeof(message), "broker=%d,failovers=%lu,lastOutageMs=%lu,maxOutageMs=%lu,"
+           "probeCriticalUs=%lu/%lu,probeBulkUs=%lu/%lu,probesLost=%lu",
+           activeBroker(), linkMetrics.failovers, linkMetrics.lastOutageMs, linkMetrics.maxOutageMs,
+           linkMetrics.probeRttUs[TRAFFIC_CRITICAL], linkMetrics.probeMaxUs[TRAFFIC_CRITICAL],
+           linkMetrics.probeRttUs[TRAFFIC_BULK], linkMetrics.probeMaxUs[TRAFFIC_BULK],
+           linkMetrics.probesLost);
+  publish(telemetry_topic, message, TRAFFIC_BULK);
+
+  unsigned long reads, evaluations;
+  derivedStats(reads, evaluations);
+  snprintf(message, sizeof(message), "derivedReads=%lu,derivedEvals=%lu", reads, evaluations);
+  publish(telemetry_topic, message, TRAFFIC_BULK);
+
+  formatEnergy(message, sizeof(message));
+  publish(telemetry_topic, message, TRAFFIC_BULK);
+
+#if ISR_TIMING
+  length = formatHistogram(message, sizeof(message), "isrGpio", isrTiming.gpio);
+  length += formatHistogram(message + length, sizeof(message) - length, ",isrTimer", isrTiming.timer);
+  formatHistogram(message + length, sizeof(message) - length, ",timerLate", isrTiming.timerLatency);
+  publish(telemetry_topic, message, TRAFFIC_BULK);
+#endif
+}
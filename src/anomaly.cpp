@@ -0,0 +1,44 @@
+#include "constants.h"
+
+static const char* faultNames[] = {"none", "stuck_high", "flood", "silence"};
+
+static AnomalyDetector detector;
+static SensorFault reportedFault = FAULT_NONE;
+static uint8_t lastLevel = LOW;
+
+void beginSensorHealth()
+{
+  AnomalyConfig config = {STUCK_HIGH_MS, EDGE_RATE_FLOOR, EDGE_RATE_FACTOR, SILENCE_MS, SILENCE_MIN_RATE};
+  detector.begin(config, millis());
+}
+
+/*
+* Run from loop(): feeds the detector and reports each change of fault state
+*/
+void checkSensorHealth()
+{
+  uint8_t level = digitalRead(motionSensor);
+  if(level != lastLevel)
+  {
+    lastLevel = level;
+    recordInput(IO_PIN_LEVEL, &level, 1);
+  }
+
+  SensorFault fault = detector.update(millis(), room.edges, level == HIGH, localHour());
+  if(fault == reportedFault)
+  {
+    return;
+  }
+  reportedFault = fault;
+  Serial.print("Sensor fault: ");
+  Serial.println(faultNames[fault]);
+
+  char message[32];
+  snprintf(message, sizeof(message), "fault=%s", faultNames[fault]);
+  publish(fault_topic, message);
+}
+
+bool sensorFaulted()
+{
+  return detector.suppressing();
+}
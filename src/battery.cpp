@@ -0,0 +1,180 @@
+#include "constants.h"
+
+#if BATTERY_PROFILE
+
+// Read the supply voltage on the ADC instead of the A0 pin
+ADC_MODE(ADC_VCC);
+
+// Kept in RTC memory across deep sleep. A bad checksum means a cold boot,
+// which starts over with a full scan.
+struct BatteryCache
+{
+  uint32_t checksum;
+  uint8_t bssid[6];
+  uint8_t channel;
+  // Index into wifi_networks, BATTERY_NO_AP when nothing is cached
+  uint8_t network;
+  uint8_t broker;
+  uint8_t reserved[3];
+  uint32_t wakes;
+  uint32_t missed;
+  // Previous wake: boot to publish, boot to sleep and modelled charge
+  uint32_t lastPublishMs;
+  uint32_t lastAwakeMs;
+  uint32_t lastChargeUaMs;
+};
+
+#define BATTERY_NO_AP 0xff
+
+static BatteryCache cache;
+
+static uint32_t cacheChecksum()
+{
+  const uint8_t* bytes = (const uint8_t*)&cache + sizeof(cache.checksum);
+  uint32_t hash = 2166136261UL;
+  for(size_t i = 0; i < sizeof(cache) - sizeof(cache.checksum); i++)
+  {
+    hash = (hash ^ bytes[i]) * 16777619UL;
+  }
+  return hash;
+}
+
+static void loadCache()
+{
+  if(!ESP.rtcUserMemoryRead(0, (uint32_t*)&cache, sizeof(cache)) || cache.checksum != cacheChecksum())
+  {
+    memset(&cache, 0, sizeof(cache));
+    cache.network = BATTERY_NO_AP;
+  }
+}
+
+static void saveCache()
+{
+  cache.checksum = cacheChecksum();
+  ESP.rtcUserMemoryWrite(0, (uint32_t*)&cache, sizeof(cache));
+}
+
+static bool expired(unsigned long deadline)
+{
+  return (long)(millis() - deadline) >= 0;
+}
+
+// Join the cached AP on its channel, skipping the scan
+static bool beginCachedJoin()
+{
+  if(cache.network >= wifi_network_count)
+  {
+    return false;
+  }
+  const WifiNetwork& network = wifi_networks[cache.network];
+  WiFi.begin(network.ssid, network.password, cache.channel, cache.bssid);
+  return true;
+}
+
+static bool waitForWifi(unsigned long deadline)
+{
+  while(WiFi.status() != WL_CONNECTED && !expired(deadline))
+  {
+    delay(5);
+  }
+  return WiFi.status() == WL_CONNECTED;
+}
+
+static void rememberAP()
+{
+  cache.network = BATTERY_NO_AP;
+  for(int i = 0; i < wifi_network_count; i++)
+  {
+    if(WiFi.SSID() == wifi_networks[i].ssid)
+    {
+      cache.network = i;
+    }
+  }
+  memcpy(cache.bssid, WiFi.BSSID(), sizeof(cache.bssid));
+  cache.channel = WiFi.channel();
+}
+
+// Last broker that worked first, then the rest in order
+static bool connectBroker(unsigned long deadline)
+{
+  espClient.setTimeout(MQTT_CONNECT_TIMEOUT_MS);
+  for(int i = 0; i < mqtt_broker_count && !expired(deadline); i++)
+  {
+    int broker = (cache.broker + i) % mqtt_broker_count;
+    client.setServer(mqtt_brokers[broker].host, mqtt_brokers[broker].port);
+    if(client.connect("ESP8266Client", mqtt_user, mqtt_pass))
+    {
+      cache.broker = broker;
+      return true;
+    }
+  }
+  return false;
+}
+
+/*
+* Fast path for a wake: join the cached AP, publish a status line, and go
+* back to deep sleep. Only a wake from the PIR pulling RST (an external
+* reset) also publishes the motion event; a power-up or a heartbeat timer
+* wake does not. Does not return.
+*/
+void batteryWake()
+{
+  beginEnergy();
+  loadCache();
+  cache.wakes++;
+  uint32_t reason = ESP.getResetInfoPtr()->reason;
+  // RST pulled during deep sleep can also report a deep sleep wake; with no
+  // heartbeat timer armed nothing else can have woken the node
+  bool motion = reason == REASON_EXT_SYS_RST ||
+                (reason == REASON_DEEP_SLEEP_AWAKE && BATTERY_HEARTBEAT_S == 0);
+
+  unsigned long deadline = millis() + BATTERY_WAKE_WINDOW_MS;
+  // Keep flash writes out of the wake path
+  WiFi.persistent(false);
+  WiFi.mode(WIFI_STA);
+  bool joining = beginCachedJoin();
+
+  // Built while the radio associates
+  char status[PAYLOAD_SIZE];
+  snprintf(status, sizeof(status), "seq=%lu,reset=%lu,missed=%lu,vcc=%u,lastPublishMs=%lu,lastAwakeMs=%lu,lastUaMs=%lu",
+           (unsigned long)cache.wakes, (unsigned long)reason, (unsigned long)cache.missed, ESP.getVcc(),
+           (unsigned long)cache.lastPublishMs, (unsigned long)cache.lastAwakeMs,
+           (unsigned long)cache.lastChargeUaMs);
+
+  if(!(joining && waitForWifi(deadline)))
+  {
+    // The AP moved or the cache is cold: fall back to the full scan
+    connectToWifi();
+  }
+
+  bool sent = false;
+  unsigned long publishMs = 0;
+  if(WiFi.status() == WL_CONNECTED)
+  {
+    rememberAP();
+    if(connectBroker(deadline))
+    {
+      espClient.setNoDelay(true);
+      enterPhase(PHASE_TX);
+      sent = !motion || client.publish(motion_detect_topic, "Motion Detected in the Bathroom!!!");
+      sent = client.publish(telemetry_topic, status) && sent;
+      publishMs = millis();
+      // Sends DISCONNECT and flushes the socket before the radio goes down
+      client.disconnect();
+      endPhase();
+    }
+  }
+
+  if(!sent)
+  {
+    cache.missed++;
+  }
+  cache.lastPublishMs = publishMs;
+  cache.lastChargeUaMs = energyChargeUaMs();
+  cache.lastAwakeMs = millis();
+  saveCache();
+
+  ESP.deepSleep(BATTERY_HEARTBEAT_S * 1000000ULL, WAKE_RF_DEFAULT);
+}
+
+#endif // BATTERY_PROFILE
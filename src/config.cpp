@@ -0,0 +1,215 @@
+#include "constants.h"
+#include <LittleFS.h>
+
+static const char* configPath = "/config.bin";
+static const char* configTempPath = "/config.tmp";
+
+static const char* statusNames[] = {"applied", "rejected", "stale", "rolledback"};
+
+enum ConfigStatus
+{
+  CONFIG_APPLIED,
+  CONFIG_REJECTED,
+  CONFIG_STALE,
+  CONFIG_ROLLEDBACK
+};
+
+// Last known good config, restored on rollback
+static NodeProfile previousProfiles[SCHEDULE_PROFILES];
+static uint16_t previousVersion = 0;
+static bool onProbation = false;
+static unsigned long probationStart = 0;
+static bool faultedBefore = false;
+static bool poorLinkBefore = false;
+
+static void acknowledge(uint16_t version, ConfigStatus status)
+{
+  char message[40];
+  snprintf(message, sizeof(message), "version=%u,status=%s", version, statusNames[status]);
+  publish(config_ack_topic, message);
+}
+
+/*
+* The running config survives a reboot as [SPC1][version u16][profiles].
+* It is written to a temporary file and renamed over the old one, so a
+* power cut mid-write leaves the previous config in place.
+*/
+static void saveConfig()
+{
+  File file = LittleFS.open(configTempPath, "w");
+  if(!file)
+  {
+    return;
+  }
+  uint8_t header[6] = {'S', 'P', 'C', '1', (uint8_t)(configVersion >> 8), (uint8_t)configVersion};
+  bool written = file.write(header, sizeof(header)) == sizeof(header) &&
+                 file.write((const uint8_t*)profiles, sizeof(profiles)) == sizeof(profiles);
+  file.close();
+  if(!written || !LittleFS.rename(configTempPath, configPath))
+  {
+    Serial.println("Failed to save config!!!");
+  }
+}
+
+// A file from a build with a different profile layout is ignored
+static bool loadConfig()
+{
+  File file = LittleFS.open(configPath, "r");
+  if(!file)
+  {
+    return false;
+  }
+  uint8_t header[6];
+  NodeProfile loaded[SCHEDULE_PROFILES];
+  bool valid = file.size() == sizeof(header) + sizeof(loaded) &&
+               file.read(header, sizeof(header)) == sizeof(header) &&
+               memcmp(header, "SPC1", 4) == 0 &&
+               file.read((uint8_t*)loaded, sizeof(loaded)) == sizeof(loaded);
+  file.close();
+  if(!valid)
+  {
+    return false;
+  }
+  memcpy(profiles, loaded, sizeof(profiles));
+  configVersion = (header[4] << 8) | header[5];
+  return true;
+}
+
+static bool setField(NodeProfile* target, uint8_t key, uint32_t value)
+{
+  uint8_t profile = key / CONFIG_PROFILE_FIELDS;
+  if(profile >= SCHEDULE_PROFILES)
+  {
+    return false;
+  }
+  NodeProfile& p = target[profile];
+  switch(key % CONFIG_PROFILE_FIELDS)
+  {
+    case 0:
+      p.holdMs = value;
+      return value > 0;
+    case 1:
+      p.refreshMs = value;
+      return value > 0;
+    case 2:
+      p.telemetryMs = value;
+      return value >= 1000;
+    default:
+      p.sleepMode = (WiFiSleepType_t)value;
+      return value <= WIFI_MODEM_SLEEP;
+  }
+}
+
+static void rollback()
+{
+  uint16_t failed = configVersion;
+  memcpy(profiles, previousProfiles, sizeof(profiles));
+  configVersion = previousVersion;
+  onProbation = false;
+  refreshProfile();
+  saveConfig();
+  Serial.print("Config rolled back to version ");
+  Serial.println(configVersion);
+  acknowledge(failed, CONFIG_ROLLEDBACK);
+}
+
+static void onConfigMessage(const char* topic, const byte* payload, unsigned int length)
+{
+  static ConfigDelta delta;
+  if(!delta.parse(payload, length))
+  {
+    acknowledge(configVersion, CONFIG_REJECTED);
+    return;
+  }
+
+  if(delta.type == CONFIG_DELTA_ROLLBACK)
+  {
+    if(delta.version == configVersion && configVersion != previousVersion)
+    {
+      rollback();
+      return;
+    }
+    // Not the running version, or nothing kept to go back to
+    acknowledge(delta.version, CONFIG_REJECTED);
+    return;
+  }
+
+  if(delta.version == configVersion)
+  {
+    // Redelivery of the delta we already run
+    acknowledge(configVersion, CONFIG_APPLIED);
+    return;
+  }
+  if(delta.baseVersion != configVersion)
+  {
+    acknowledge(configVersion, CONFIG_STALE);
+    return;
+  }
+
+  // Stage on a copy so a bad entry leaves the running config untouched
+  NodeProfile staged[SCHEDULE_PROFILES];
+  memcpy(staged, profiles, sizeof(staged));
+  for(uint8_t i = 0; i < delta.count; i++)
+  {
+    if(!setField(staged, delta.entries[i].key, delta.entries[i].value))
+    {
+      acknowledge(delta.version, CONFIG_REJECTED);
+      return;
+    }
+  }
+
+  memcpy(previousProfiles, profiles, sizeof(profiles));
+  previousVersion = configVersion;
+  memcpy(profiles, staged, sizeof(profiles));
+  configVersion = delta.version;
+  refreshProfile();
+  saveConfig();
+
+  onProbation = true;
+  probationStart = millis();
+  faultedBefore = sensorFaulted();
+  poorLinkBefore = linkGrade() == LINK_POOR;
+  Serial.print("Config version ");
+  Serial.print(configVersion);
+  Serial.println(" applied");
+  acknowledge(configVersion, CONFIG_APPLIED);
+}
+
+void beginConfig()
+{
+  if(LittleFS.begin() && loadConfig())
+  {
+    refreshProfile();
+    Serial.print("Config version ");
+    Serial.print(configVersion);
+    Serial.println(" loaded");
+  }
+  // Rollback only reaches back to a delta applied since this boot
+  memcpy(previousProfiles, profiles, sizeof(profiles));
+  previousVersion = configVersion;
+  if(!addTopicRoute(config_topic, onConfigMessage))
+  {
+    Serial.println("Config deltas will not be received");
+  }
+}
+
+/*
+* Watch a freshly applied config; a sensor fault or poor link that was not
+* there before the change is treated as a regression caused by it.
+*/
+void configLoop()
+{
+  if(!onProbation)
+  {
+    return;
+  }
+  if((sensorFaulted() && !faultedBefore) || (linkGrade() == LINK_POOR && !poorLinkBefore))
+  {
+    rollback();
+    return;
+  }
+  if(millis() - probationStart > CONFIG_PROBATION_MS)
+  {
+    onProbation = false;
+  }
+}
@@ -4,6 +4,7 @@
 #include <Arduino.h>
 #include <ESP8266WiFi.h>
 #include <PubSubClient.h>
+#include <SpottyCore.h>
 
 #define timeSeconds 2
  
@@ -11,33 +12,480 @@
 const int led = 14;
 const int motionSensor = 4;
 
+// PIR zones covering the room, one per stall or area. motionSensor is zone 0;
+// add pins here for multi-stall restrooms (at most PEOPLE_MAX_ZONES).
+const int zoneSensors[] = {motionSensor};
+const int zoneCount = sizeof(zoneSensors) / sizeof(zoneSensors[0]);
+
 // Timer: Auxiliary variables
 extern unsigned long now;
-extern unsigned long lastTrigger;
-extern boolean startTimer;
+
+// Motion input for the room this node covers. The fields written on every
+// edge are kept together in one struct so an update touches a single small
+// block of RAM; volatile because the ISR writes them.
+struct RoomState
+{
+  unsigned long lastTrigger;
+  unsigned long edges;
+  boolean motionPending;
+  uint8_t pendingZones;
+  uint8_t maskedZones;
+  uint8_t maskLevels;
+  unsigned long suppressedEdges;
+  unsigned long zoneTrigger[PEOPLE_MAX_ZONES];
+  unsigned long zoneRise[PEOPLE_MAX_ZONES];
+};
+
+extern volatile RoomState room;
+
+// Both PIR edges with pulse widths, from the ISR to the loop
+extern EdgeRing edgeRing;
+
+// GPIO edge filter. After an edge the zone's interrupt is masked in
+// hardware and re-armed by timer1 GPIO_FILTER_MS later, so each zone
+// interrupts at most twice per window however noisy the input. An edge is
+// counted as suppressed when the pin level at re-arm differs from the level
+// at masking, which makes the count a lower bound; the missed edge is
+// still delivered, stamped with the re-arm time.
+#define GPIO_FILTER_MS 100
+
+// Both PIR edges are captured; the ISR measures each pulse and queues the
+// edges in edgeRing for the loop.
+void recordEdge(uint8_t zone, uint8_t level, unsigned long ms);
+
+// ISR timing in CPU cycles. gpio and timer are handler durations;
+// timerLatency is how late timer1 fired against the cycle count it was
+// armed for. Everything an ISR reaches must stay in IRAM, which
+// scripts/iram_audit.py checks after every build. Build with
+// -D ISR_TIMING=0 to compile the timing out.
+#ifndef ISR_TIMING
+#define ISR_TIMING 1
+#endif
+// Histogram unit of 64 cycles, 0.8 us at 80 MHz
+#define ISR_TIMING_UNIT_SHIFT 6
+
+struct IsrTiming
+{
+  CycleHistogram gpio;
+  CycleHistogram timer;
+  CycleHistogram timerLatency;
+};
+
+extern IsrTiming isrTiming;
+
+// Occupancy state machine fed from room by the loop
+extern Occupancy occupancy;
+
+// Outbound admission control. Occupancy transitions are always published;
+// repeated "still occupied" events only go out while the bucket has tokens,
+// so a stuck or noisy PIR cannot flood the broker.
+#define PUBLISH_BUCKET_SIZE 3
+#define PUBLISH_REFILL_MS 5000
+#define TRANSITION_SLO_MS 250
+#define TELEMETRY_INTERVAL_MS 60000
+
+enum EventClass
+{
+  EVENT_TRANSITION,
+  EVENT_REFRESH
+};
+
+struct PublishMetrics
+{
+  unsigned long transitions;
+  unsigned long refreshes;
+  unsigned long shed;
+  unsigned long maxLatencyMs;
+  unsigned long sloMisses;
+  unsigned long rejectedMessages;
+  unsigned long stateBytes;
+  unsigned long pulses;
+  unsigned long totalPulseMs;
+  unsigned long maxPulseMs;
+  unsigned long renders;
+  unsigned long totalRenderUs;
+  unsigned long maxRenderUs;
+};
+
+extern PublishMetrics metrics;
+
+// Sensor anomaly detection. Edge rates are learned per hour of day once the
+// clock is synced; until then only the absolute floor applies.
+#define STUCK_HIGH_MS (15UL * 60UL * 1000UL)
+#define EDGE_RATE_FLOOR 30
+#define EDGE_RATE_FACTOR 4
+#define SILENCE_MS (8UL * 60UL * 60UL * 1000UL)
+#define SILENCE_MIN_RATE 2
 
 // WiFI Creds=entials
-extern const char* ssid;
-extern const char* password;
+struct WifiNetwork
+{
+  const char* ssid;
+  const char* password;
+};
+
+extern const WifiNetwork wifi_networks[];
+extern const int wifi_network_count;
+
+// Roaming: while the room is idle and RSSI is below the threshold, scan in
+// the background and move to a known AP that is at least the margin stronger.
+#define ROAM_RSSI_THRESHOLD -75
+#define ROAM_RSSI_MARGIN 8
+#define ROAM_SCAN_INTERVAL_MS 60000
+// A roam join that has not connected by then falls back to connectToWifi()
+#define ROAM_JOIN_TIMEOUT_MS 10000
+
+// Publish latency per RSSI band: >= -60, >= -70, >= -80 and below -80 dBm
+#define RSSI_BANDS 4
+
+struct LinkMetrics
+{
+  unsigned long publishes[RSSI_BANDS];
+  unsigned long totalLatencyUs[RSSI_BANDS];
+  unsigned long maxLatencyUs[RSSI_BANDS];
+  unsigned long roams;
+  unsigned long failovers;
+  unsigned long lastOutageMs;
+  unsigned long maxOutageMs;
+  // Loopback probe round trip, indexed by TrafficClass
+  unsigned long probeRttUs[2];
+  unsigned long probeMaxUs[2];
+  unsigned long probesLost;
+};
+
+extern LinkMetrics linkMetrics;
+
+// Link quality driven scheduling. On a degraded link refreshes are batched
+// to one per LINK_DEGRADED_REFRESH_MS and telemetry slows down; on a poor
+// link refreshes are deferred entirely. Transitions are always sent.
+#define LINK_DEGRADED_RSSI -75
+#define LINK_POOR_RSSI -85
+#define LINK_DEGRADED_RTT_US 50000
+#define LINK_POOR_RTT_US 250000
+#define LINK_DEGRADED_REFRESH_MS 30000
+
+extern LinkQuality linkQuality;
+
+// Time of day profiles. The schedule ("HH:MM=p,...") can be replaced at
+// runtime through schedule_topic; the active profile sets hold time,
+// refresh coalescing, telemetry rate and WiFi sleep depth.
+#define SCHEDULE_PROFILES 2
+#define SCHEDULE_DEFAULT "07:00=0,23:00=1"
+#define SCHEDULE_CLOCK_RETRY_MS 60000
+
+struct NodeProfile
+{
+  unsigned long holdMs;
+  unsigned long refreshMs;
+  unsigned long telemetryMs;
+  WiFiSleepType_t sleepMode;
+};
+
+extern NodeProfile profiles[SCHEDULE_PROFILES];
+extern const NodeProfile* activeProfile;
+
+// Versioned runtime config. Delta keys address profile fields as
+// profile * CONFIG_PROFILE_FIELDS + field (hold, refresh, telemetry, sleep).
+// A delta that is followed by a health regression inside the probation
+// window is rolled back by the node itself.
+#define CONFIG_PROFILE_FIELDS 4
+#define CONFIG_PROBATION_MS (5UL * 60UL * 1000UL)
+
+extern uint16_t configVersion;
+
+// Record every external input to flash so field issues can be replayed on
+// the host with IoLogReader. Build with -D IO_RECORDING=0 to compile it out.
+#ifndef IO_RECORDING
+#define IO_RECORDING 1
+#endif
+#define IO_LOG_BUFFER_SIZE 512
+#define IO_LOG_FLUSH_MS 30000
+#define IO_LOG_MAX_BYTES (64UL * 1024UL)
+#define IO_LOG_CHUNK_SIZE 200
+#define IO_LOG_UPLOAD_MIN_INTERVAL_MS 60000
+
+// Flow from adjacent rooms. Motion published by the nodes listed in
+// adjacent_topics is correlated with arrivals here; when an adjacent event
+// has led to an arrival often enough, an arrival prediction is published.
+// Every node publishes its own motion on NODE_MOTION_TOPIC (payload slot
+// NODE_MOTION_SLOT); list the neighbours' node topics, not the shared
+// motion_detect_topic, which this node publishes too.
+#define FLOW_WINDOW_MS 60000
+#define FLOW_BUCKET_MS (60UL * 60UL * 1000UL)
+#define FLOW_MIN_SAMPLES 5
+#define FLOW_PREDICT_PERCENT 50
+
+// Delta-only state reporting. The state vector is published as bit-packed
+// deltas against the last state the gateway acknowledged on state_ack_topic
+// (2 byte big-endian sequence), with a keyframe every STATE_KEYFRAME_MS or
+// whenever nothing has been acknowledged yet.
+#define STATE_KEYFRAME_MS (10UL * 60UL * 1000UL)
+#define STATE_HISTORY 4
+#define STATE_FRAME_SIZE 64
+
+// Hourly occupancy history for the gateway to backfill from, exported in
+// the columnar HistoryColumns layout. On flash one row per hour is
+// appended to a file that rotates after HISTORY_SLOTS rows, so between
+// HISTORY_SLOTS and twice that many hours are kept.
+#define HISTORY_SLOTS (90 * 24)
+#define HISTORY_EXPORT_MIN_INTERVAL_MS 60000
+
+// Payload outputs. Each slot renders a PayloadTemplate to its topic on the
+// occupancy events in its mask. Slots are replaced at runtime through
+// template_topic with "slot\nevents\ntopic\ntemplate", where events is any
+// of 'e' (entered), 'r' (refreshed) and 'v' (vacated); an empty template
+// disables the slot.
+#define PAYLOAD_OUTPUTS 4
+#define PAYLOAD_TOPIC_SIZE 48
+#define PAYLOAD_SIZE 128
+
+enum PayloadField
+{
+  PAYLOAD_OCCUPIED,
+  PAYLOAD_EVENT,
+  PAYLOAD_COUNT,
+  PAYLOAD_COUNT_LOW,
+  PAYLOAD_ZONES,
+  PAYLOAD_UPTIME_MS,
+  PAYLOAD_CONFIG,
+  PAYLOAD_SEQ,
+  PAYLOAD_FIELDS
+};
+
+enum StateField
+{
+  STATE_OCCUPIED,
+  STATE_ZONES,
+  STATE_COUNT,
+  STATE_COUNT_LOW,
+  STATE_ENTRIES,
+  STATE_OCCUPIED_SECONDS,
+  STATE_ZONE_SECONDS
+};
 
 // MQTT Credentials
-extern const char* mqtt_server;
+struct MqttBroker
+{
+  const char* host;
+  int port;
+};
+
+extern const MqttBroker mqtt_brokers[];
+extern const int mqtt_broker_count;
 extern const char* mqtt_user;
 extern const char* mqtt_pass;
-extern const int mqtt_port;
 
 extern const char* motion_detect_topic;
+extern const char* telemetry_topic;
+extern const char* fault_topic;
+extern const char* schedule_topic;
+extern const char* config_topic;
+extern const char* config_ack_topic;
+extern const char* io_log_topic;
+extern const char* io_log_data_topic;
+extern const char* prediction_topic;
+// Also the state_topic of the Home Assistant people sensor
+#define COUNT_TOPIC "motionCount"
+extern const char* count_topic;
+extern const char* state_topic;
+extern const char* state_ack_topic;
+extern const char* history_topic;
+extern const char* history_data_topic;
+extern const char* template_topic;
+extern const char* adjacent_topics[FLOW_MAX_SOURCES];
+
+extern const char* ntp_server;
+extern const char* time_zone;
 
 extern WiFiClient espClient;
 extern PubSubClient client;
 
+// Broker failover. mqttLoop() makes at most one connect attempt per pass,
+// to the healthiest broker in mqtt_brokers that is not backing off, so a
+// dead broker costs MQTT_CONNECT_TIMEOUT_MS per attempt instead of blocking
+// the loop. With MQTT_DUAL_HOME set a standby session is kept open to a
+// second broker and critical publishes go to both, including while the
+// primary is down. The built-in motion payloads then end in seq=${seq} for
+// the receiver to drop the duplicate.
+#ifndef MQTT_DUAL_HOME
+#define MQTT_DUAL_HOME 0
+#endif
+#define MQTT_CONNECT_TIMEOUT_MS 1500
+#define MQTT_RETRY_MS 1000
+#define MQTT_RETRY_MAX_MS 30000
+
+// TCP and MQTT session tuning. Set MQTT_TCP_NODELAY to 0 to compare the
+// loopback probe round trips (probeCriticalUs, probeBulkUs in telemetry)
+// with Nagle left on for every traffic class.
+#define MQTT_TCP_NODELAY 1
+#define LATENCY_PROBE_MS 60000
+#define MQTT_KEEPALIVE_S 15
+#define MQTT_SOCKET_TIMEOUT_S 5
+#define TCP_KEEPALIVE_IDLE_S 10
+#define TCP_KEEPALIVE_INTERVAL_S 5
+#define TCP_KEEPALIVE_COUNT 3
+#define MQTT_BUFFER_SIZE 256
+
+// Critical traffic (occupancy, faults) is sent without Nagle delay; bulk
+// traffic (telemetry) may be coalesced by the stack.
+enum TrafficClass
+{
+  TRAFFIC_CRITICAL,
+  TRAFFIC_BULK
+};
+
 // MQTT function definitions
-void publish(const char* topic_name, const char* message);
+void publish(const char* topic_name, const char* message, TrafficClass trafficClass = TRAFFIC_CRITICAL,
+             bool retained = false);
+void publish(const char* topic_name, const uint8_t* payload, unsigned int length,
+             TrafficClass trafficClass = TRAFFIC_CRITICAL, bool retained = false);
 void setMQTTClient();
+void mqttLoop();
+int activeBroker();
+
+// MQTT topic routing through a TopicRouter. Filters may use the '+' and
+// '#' wildcards and must outlive the route (string literals or other
+// static storage). The table holds one route each for config, schedule,
+// template, state ack, history, IO log upload and the latency probe, plus
+// one per adjacent room; update FIXED_TOPIC_ROUTES when adding a route.
+#define FIXED_TOPIC_ROUTES 7
+#define MAX_TOPIC_ROUTES (FIXED_TOPIC_ROUTES + FLOW_MAX_SOURCES)
+
+// Inbound messages larger than this are dropped before any handler sees
+// them; every handler payload is bounded by it.
+#define MQTT_MAX_INBOUND 128
+
+bool addTopicRoute(const char* filter, TopicHandler handler);
+
+// Admission and telemetry function definitions
+void beginAdmission();
+void setRefreshPeriod(unsigned long refreshMs);
+bool admitEvent(EventClass eventClass);
+void recordTransitionLatency(unsigned long latencyMs);
+void reportTelemetry();
+
+// Anomaly detection function definitions
+void beginSensorHealth();
+void checkSensorHealth();
+bool sensorFaulted();
+
+// Derived values. Read on every loop pass but recomputed only after an
+// input changed (onLinkChanged, onProfileChanged) or, for clock values,
+// when the hour turns; see DerivedValue. Until SNTP has synced the clock
+// values are retried every DERIVED_CLOCK_RETRY_MS.
+#define DERIVED_CLOCK_RETRY_MS 1000
+
+void beginDerived();
+void onLinkChanged();
+void onProfileChanged();
+int localHour();
+long epochHour();
+LinkGrade linkGrade();
+unsigned long telemetryInterval();
+void derivedStats(unsigned long& reads, unsigned long& evaluations);
+
+// Energy estimate. Time is counted per radio phase on the node and priced
+// with a per-phase current model (datasheet figures for the ESP8266 at
+// 3.3 V, in uA); replace them with bench measurements of the actual board.
+#define POWER_TX_UA 170000UL
+#define POWER_CONNECT_UA 80000UL
+#define POWER_LISTEN_UA 56000UL
+#define POWER_MODEM_SLEEP_UA 15000UL
+#define POWER_LIGHT_SLEEP_UA 900UL
+
+void beginEnergy();
+void enterPhase(PowerPhase phase);
+void endPhase();
+void energyLoop();
+void formatEnergy(char* out, size_t size);
+uint32_t energyChargeUaMs();
+
+// Battery variant, built by the modwifi_battery environment. The PIR drives
+// RST through a pulse shaper, so motion wakes the node from deep sleep;
+// setup() then runs batteryWake(), which joins the AP cached in RTC memory,
+// publishes a status line, plus the motion event when the reset came from
+// the PIR, and sleeps again without reaching loop(). Hold time and vacancy
+// are left to the receiver.
+// BATTERY_HEARTBEAT_S > 0 also wakes on a timer (GPIO16 tied to RST).
+#ifndef BATTERY_PROFILE
+#define BATTERY_PROFILE 0
+#endif
+#define BATTERY_WAKE_WINDOW_MS 3000
+#define BATTERY_HEARTBEAT_S 0
+
+void batteryWake();
+
+// Schedule function definitions
+void beginSchedule();
+void scheduleLoop();
+void refreshProfile();
+
+// Config function definitions
+void beginConfig();
+void configLoop();
+
+// Input recording function definitions
+#if IO_RECORDING
+void beginIoLog();
+void ioLogLoop();
+void recordInput(IoRecordType type, const void* data, uint8_t length);
+#else
+inline void beginIoLog() {}
+inline void ioLogLoop() {}
+inline void recordInput(IoRecordType, const void*, uint8_t) {}
+#endif
+
+// Flow correlation function definitions
+void beginFlow();
+void onLocalArrival();
+
+// People count function definitions
+void beginPeopleCount();
+void onZoneMotion(uint8_t zones);
+void onZoneLevels(uint8_t highZones, uint32_t ms);
+void peopleCountLoop();
+
+// GPIO filter function definitions
+void beginGpioFilter();
+void maskZone(uint8_t zone);
+const PeopleCounter& peopleCounter();
+
+// State report function definitions
+void beginStateReport();
+void reportState();
+void stateReportLoop();
+
+// Payload function definitions
+void beginPayloads();
+void publishEvent(OccupancyEvent event);
+bool setOutput(uint8_t slot, uint8_t events, const char* topic, uint32_t topicLength,
+               const char* source, uint32_t sourceLength, bool retained = false);
+
+// Home Assistant MQTT discovery. Discovery configs are compiled into flash
+// and published retained once per broker; occupancy state goes out retained
+// through payload slot HA_PAYLOAD_SLOT. HA_NODE_ID must be unique per node.
+#define HA_NODE_ID "spottypotty_bathroom"
+#define HA_DISCOVERY_PREFIX "homeassistant"
+#define HA_STATE_TOPIC "spottypotty/" HA_NODE_ID "/occupancy"
+#define HA_AVAILABILITY_TOPIC "spottypotty/" HA_NODE_ID "/availability"
+#define LATENCY_PROBE_TOPIC "spottypotty/" HA_NODE_ID "/probe"
+#define NODE_MOTION_TOPIC "spottypotty/" HA_NODE_ID "/motion"
+#define NODE_MOTION_SLOT 2
+#define HA_PAYLOAD_SLOT 1
+#define HA_DISCOVERY_RETRY_MS 10000
+
+void beginHomeAssistant();
+void homeAssistantLoop();
+
+// History function definitions
+void beginHistory();
+void historyLoop();
 
 // WiFi function Defintions
 void connectToWifi();
 void WifiConnectionStatus();
+void roamIfNeeded(bool idle);
+int rssiBand(int32_t rssi);
 
 
 #endif // __CONSTANTS_H__
\ No newline at end of file
@@ -0,0 +1,127 @@
+#include "constants.h"
+
+// Values the loop reads on every pass but whose inputs change rarely:
+// the clock hours change once an hour, the link grade only when a publish
+// is scored and the telemetry interval only with the grade or the profile.
+static DerivedValue hourOfDay;
+static DerivedValue hourOfEpoch;
+static DerivedValue gradeOfLink;
+static DerivedValue telemetryMs;
+
+// Milliseconds until the UTC clock reaches the next full hour
+static uint32_t untilNextHour(time_t t)
+{
+  return (3600UL - (uint32_t)(t % 3600)) * 1000UL;
+}
+
+// Milliseconds until the local clock reaches the next full hour, which in a
+// half-hour time zone is not the UTC one
+static uint32_t untilNextLocalHour(const struct tm& local)
+{
+  // tm_sec may be 60 on a leap second
+  uint32_t into = min(local.tm_min * 60 + local.tm_sec, 3599);
+  return (3600UL - into) * 1000UL;
+}
+
+static int32_t computeHourOfDay(uint32_t /* nowMs */, uint32_t& validMs)
+{
+  time_t t = time(nullptr);
+  if(t < 1600000000)
+  {
+    validMs = DERIVED_CLOCK_RETRY_MS;
+    return -1;
+  }
+  struct tm local;
+  localtime_r(&t, &local);
+  validMs = untilNextLocalHour(local);
+  return local.tm_hour;
+}
+
+static int32_t computeHourOfEpoch(uint32_t /* nowMs */, uint32_t& validMs)
+{
+  time_t t = time(nullptr);
+  if(t < 1600000000)
+  {
+    validMs = DERIVED_CLOCK_RETRY_MS;
+    return -1;
+  }
+  validMs = untilNextHour(t);
+  return t / 3600;
+}
+
+// Valid until a scored publish invalidates it
+static int32_t computeLinkGrade(uint32_t /* nowMs */, uint32_t& /* validMs */)
+{
+  return linkQuality.grade();
+}
+
+// Telemetry is non-critical, so it backs off as the link gets worse
+static int32_t computeTelemetryInterval(uint32_t nowMs, uint32_t& validMs)
+{
+  switch(gradeOfLink.get(nowMs, validMs))
+  {
+    case LINK_POOR:
+      return activeProfile->telemetryMs * 4;
+    case LINK_DEGRADED:
+      return activeProfile->telemetryMs * 2;
+    default:
+      return activeProfile->telemetryMs;
+  }
+}
+
+void beginDerived()
+{
+  hourOfDay.begin(computeHourOfDay);
+  hourOfEpoch.begin(computeHourOfEpoch);
+  gradeOfLink.begin(computeLinkGrade);
+  telemetryMs.begin(computeTelemetryInterval);
+  telemetryMs.dependsOn(gradeOfLink);
+}
+
+void onLinkChanged()
+{
+  gradeOfLink.invalidate();
+}
+
+void onProfileChanged()
+{
+  telemetryMs.invalidate();
+}
+
+/*
+* Hour of day from the SNTP clock, or -1 until it has synced
+*/
+int localHour()
+{
+  return hourOfDay.get(millis());
+}
+
+/*
+* Hours since the epoch, or -1 until the clock has synced
+*/
+long epochHour()
+{
+  return hourOfEpoch.get(millis());
+}
+
+LinkGrade linkGrade()
+{
+  return (LinkGrade)gradeOfLink.get(millis());
+}
+
+unsigned long telemetryInterval()
+{
+  return telemetryMs.get(millis());
+}
+
+void derivedStats(unsigned long& reads, unsigned long& evaluations)
+{
+  const DerivedValue* values[] = {&hourOfDay, &hourOfEpoch, &gradeOfLink, &telemetryMs};
+  reads = 0;
+  evaluations = 0;
+  for(const DerivedValue* value : values)
+  {
+    reads += value->reads;
+    evaluations += value->evaluations;
+  }
+}
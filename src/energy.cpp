@@ -0,0 +1,65 @@
+#include "constants.h"
+
+static PhaseTimer phases;
+static const PowerModel model = {{POWER_TX_UA, POWER_CONNECT_UA, POWER_LISTEN_UA,
+                                  POWER_MODEM_SLEEP_UA, POWER_LIGHT_SLEEP_UA}};
+
+// Phase between radio operations, from the link state and the profile's sleep mode
+static PowerPhase idlePhase()
+{
+  if(WiFi.status() != WL_CONNECTED)
+  {
+    return PHASE_CONNECT;
+  }
+  switch(activeProfile->sleepMode)
+  {
+    case WIFI_MODEM_SLEEP:
+      return PHASE_MODEM_SLEEP;
+    case WIFI_LIGHT_SLEEP:
+      return PHASE_LIGHT_SLEEP;
+    default:
+      return PHASE_LISTEN;
+  }
+}
+
+void beginEnergy()
+{
+  phases.begin(PHASE_CONNECT, micros());
+}
+
+void enterPhase(PowerPhase phase)
+{
+  phases.enter(phase, micros());
+}
+
+void endPhase()
+{
+  phases.enter(idlePhase(), micros());
+}
+
+void energyLoop()
+{
+  endPhase();
+}
+
+// Charge drawn since beginEnergy(), in microamp milliseconds
+uint32_t energyChargeUaMs()
+{
+  endPhase();
+  return (uint32_t)model.chargeUaMs(phases);
+}
+
+/*
+* "energyUah=..,avgUa=..,txMs=..,connectMs=..,listenMs=..,modemMs=..,lightMs=.."
+*/
+void formatEnergy(char* out, size_t size)
+{
+  endPhase();
+  snprintf(out, size, "energyUah=%lu,avgUa=%lu,txMs=%lu,connectMs=%lu,listenMs=%lu,modemMs=%lu,lightMs=%lu",
+           (unsigned long)model.chargeUah(phases), (unsigned long)model.averageUa(phases),
+           (unsigned long)(phases.totalUs[PHASE_TX] / 1000),
+           (unsigned long)(phases.totalUs[PHASE_CONNECT] / 1000),
+           (unsigned long)(phases.totalUs[PHASE_LISTEN] / 1000),
+           (unsigned long)(phases.totalUs[PHASE_MODEM_SLEEP] / 1000),
+           (unsigned long)(phases.totalUs[PHASE_LIGHT_SLEEP] / 1000));
+}
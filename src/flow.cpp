@@ -0,0 +1,61 @@
+#include "constants.h"
+
+static FlowEstimator flow;
+
+static int sourceOf(const char* topic)
+{
+  for(int i = 0; i < FLOW_MAX_SOURCES && adjacent_topics[i]; i++)
+  {
+    if(strcmp(topic, adjacent_topics[i]) == 0)
+    {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static void onAdjacentMotion(const char* topic, const byte* payload, unsigned int length)
+{
+  int source = sourceOf(topic);
+  if(source < 0)
+  {
+    return;
+  }
+
+  int percent = flow.onUpstream(source, millis(), FLOW_MIN_SAMPLES);
+  if(percent < FLOW_PREDICT_PERCENT || occupancy.occupied)
+  {
+    return;
+  }
+
+  char message[48];
+  snprintf(message, sizeof(message), "from=%d,probability=%d", source, percent);
+  publish(prediction_topic, message);
+}
+
+void beginFlow()
+{
+  flow.begin(FLOW_WINDOW_MS, FLOW_BUCKET_MS, millis());
+  for(int i = 0; i < FLOW_MAX_SOURCES && adjacent_topics[i]; i++)
+  {
+    // A filter that covers this node's own motion would count every local
+    // arrival as an upstream event that led to itself
+    if(topicMatches(adjacent_topics[i], NODE_MOTION_TOPIC) ||
+       topicMatches(adjacent_topics[i], motion_detect_topic))
+    {
+      Serial.print("Ignoring adjacent topic that matches our own motion: ");
+      Serial.println(adjacent_topics[i]);
+      continue;
+    }
+    if(!addTopicRoute(adjacent_topics[i], onAdjacentMotion))
+    {
+      // The table is full; the remaining sources cannot fit either
+      break;
+    }
+  }
+}
+
+void onLocalArrival()
+{
+  flow.onLocalArrival(millis());
+}
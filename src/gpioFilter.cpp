@@ -0,0 +1,77 @@
+#include "constants.h"
+
+// timer1 runs from the 80 MHz APB clock; divided by 16 that is 5 ticks per us
+#define FILTER_TICKS (GPIO_FILTER_MS * 1000UL * 5UL)
+#define FILTER_CYCLES (FILTER_TICKS * (F_CPU / 5000000UL))
+
+static volatile bool timerArmed = false;
+static volatile uint32_t timerArmedAt = 0;
+
+// Re-arm every masked zone. Runs in timer1 interrupt context, so it only
+// touches GPIO registers and RAM.
+IRAM_ATTR static void rearmZones()
+{
+#if ISR_TIMING
+  uint32_t entry = ESP.getCycleCount();
+  uint32_t late = entry - timerArmedAt - FILTER_CYCLES;
+  isrTiming.timerLatency.record((int32_t)late > 0 ? late : 0);
+#endif
+  uint8_t masked = room.maskedZones;
+  for(uint8_t zone = 0; masked; zone++, masked >>= 1)
+  {
+    if(!(masked & 1))
+    {
+      continue;
+    }
+    uint8_t pin = zoneSensors[zone];
+    uint8_t level = GPIP(pin);
+    if(level != ((room.maskLevels >> zone) & 1))
+    {
+      room.suppressedEdges++;
+      recordEdge(zone, level, millis());
+    }
+    GPIEC = (1 << pin);
+    GPC(pin) = (GPC(pin) & ~(0xF << GPCI)) | (CHANGE << GPCI);
+  }
+  room.maskedZones = 0;
+  timerArmed = false;
+#if ISR_TIMING
+  isrTiming.timer.record(ESP.getCycleCount() - entry);
+#endif
+}
+
+void beginGpioFilter()
+{
+  isrTiming.gpio.begin(ISR_TIMING_UNIT_SHIFT);
+  isrTiming.timer.begin(ISR_TIMING_UNIT_SHIFT);
+  isrTiming.timerLatency.begin(ISR_TIMING_UNIT_SHIFT);
+  timer1_attachInterrupt(rearmZones);
+  timer1_enable(TIM_DIV16, TIM_EDGE, TIM_SINGLE);
+}
+
+/*
+* Called from the PIR ISR: mask this zone's interrupt and start the filter
+* window if it is not already running. Zones masked while a window runs
+* are re-armed with it, so no zone stays masked longer than one window.
+*/
+IRAM_ATTR void maskZone(uint8_t zone)
+{
+  uint8_t pin = zoneSensors[zone];
+  GPC(pin) &= ~(0xF << GPCI);
+  room.maskedZones |= (uint8_t)(1 << zone);
+  if(GPIP(pin))
+  {
+    room.maskLevels |= (uint8_t)(1 << zone);
+  }
+  else
+  {
+    room.maskLevels &= (uint8_t)~(1 << zone);
+  }
+
+  if(!timerArmed)
+  {
+    timerArmed = true;
+    timerArmedAt = ESP.getCycleCount();
+    timer1_write(FILTER_TICKS);
+  }
+}
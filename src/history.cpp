@@ -0,0 +1,220 @@
+#include "constants.h"
+#include <LittleFS.h>
+
+static const char* historyPath = "/history.rows";
+static const char* oldHistoryPath = "/history.old.rows";
+// Columnar ring written in place by earlier builds
+static const char* legacyPath = "/history.bin";
+
+static bool historyReady = false;
+static uint32_t currentHour = 0;
+static unsigned long lastSample = 0;
+static unsigned long lastExport = 0;
+
+// Counters for the hour being accumulated
+static unsigned long occupiedMs = 0;
+static unsigned long hourEdgesStart = 0;
+static unsigned long hourEntriesStart = 0;
+static uint8_t peakCount = 0;
+
+// Rows in a file; LittleFS commits a row whole or not at all
+static uint32_t rowsIn(const char* path)
+{
+  File file = LittleFS.open(path, "r");
+  if(!file)
+  {
+    return 0;
+  }
+  uint32_t rows = file.size() / HISTORY_ROW_SIZE;
+  file.close();
+  return rows;
+}
+
+/*
+* Append one row. LittleFS only reprograms the file's last block and
+* commits its metadata on an append, where a write into the middle of a
+* file copies everything from that block to the end.
+*/
+static void writeSlot(uint32_t hour)
+{
+  if(rowsIn(historyPath) >= HISTORY_SLOTS)
+  {
+    LittleFS.remove(oldHistoryPath);
+    LittleFS.rename(historyPath, oldHistoryPath);
+  }
+
+  File file = LittleFS.open(historyPath, "a");
+  if(!file)
+  {
+    return;
+  }
+  unsigned long values[HISTORY_COLUMNS] = {
+    hour,
+    min(occupiedMs / 1000UL, 0xffffUL),
+    min((unsigned long)metrics.transitions - hourEntriesStart, 0xffffUL),
+    min((unsigned long)room.edges - hourEdgesStart, 0xffffUL),
+    peakCount
+  };
+  uint8_t row[HISTORY_ROW_SIZE];
+  for(uint8_t column = 0; column < HISTORY_COLUMNS; column++)
+  {
+    historyPack(row + historyRowOffset(column), values[column], historyColumnWidth[column]);
+  }
+  file.write(row, sizeof(row));
+  file.close();
+}
+
+static void startHour(uint32_t hour)
+{
+  currentHour = hour;
+  occupiedMs = 0;
+  hourEdgesStart = room.edges;
+  hourEntriesStart = metrics.transitions;
+  peakCount = peopleCounter().count();
+}
+
+// Buffers one export chunk and publishes it when full
+struct ExportChunk
+{
+  uint16_t sequence;
+  size_t used;
+  uint8_t data[IO_LOG_CHUNK_SIZE];
+
+  void flush()
+  {
+    client.beginPublish(history_data_topic, 2 + used, false);
+    client.write(sequence >> 8);
+    client.write(sequence & 0xff);
+    client.write(data, used);
+    client.endPublish();
+    sequence++;
+    used = 0;
+    yield();
+  }
+
+  void add(const uint8_t* bytes, size_t length)
+  {
+    for(size_t i = 0; i < length; i++)
+    {
+      data[used++] = bytes[i];
+      if(used == sizeof(data))
+      {
+        flush();
+      }
+    }
+  }
+};
+
+// One column of every whole row in a file, oldest first
+static void exportColumn(ExportChunk& chunk, const char* path, uint8_t column)
+{
+  uint32_t rows = rowsIn(path);
+  File file = LittleFS.open(path, "r");
+  if(!file)
+  {
+    return;
+  }
+  uint8_t offset = historyRowOffset(column);
+  uint8_t width = historyColumnWidth[column];
+  uint8_t buffer[HISTORY_ROW_SIZE * 16];
+  while(rows > 0)
+  {
+    uint32_t batch = min(rows, (uint32_t)(sizeof(buffer) / HISTORY_ROW_SIZE));
+    if(file.read(buffer, batch * HISTORY_ROW_SIZE) != batch * HISTORY_ROW_SIZE)
+    {
+      break;
+    }
+    for(uint32_t row = 0; row < batch; row++)
+    {
+      chunk.add(buffer + row * HISTORY_ROW_SIZE + offset, width);
+    }
+    rows -= batch;
+  }
+  file.close();
+}
+
+/*
+* Stream both row files to history_data_topic as one columnar file, oldest
+* slot first and head 0, transposing as it reads so the export never holds
+* more than one chunk and one batch of rows in RAM. Each chunk is prefixed
+* with a 16 bit big-endian sequence number; an empty chunk ends it.
+*/
+static void exportHistory(const char* topic, const byte* payload, unsigned int length)
+{
+  if(!historyReady || (lastExport != 0 && millis() - lastExport < HISTORY_EXPORT_MIN_INTERVAL_MS))
+  {
+    metrics.rejectedMessages++;
+    return;
+  }
+  lastExport = millis() | 1;
+
+  uint32_t slots = rowsIn(oldHistoryPath) + rowsIn(historyPath);
+  static ExportChunk chunk;
+  chunk.sequence = 0;
+  chunk.used = 0;
+  uint8_t header[HISTORY_HEADER_SIZE] = {'S', 'P', 'H', '1'};
+  historyPack(header + 4, slots, 2);
+  chunk.add(header, sizeof(header));
+  for(uint8_t column = 0; column < HISTORY_COLUMNS; column++)
+  {
+    exportColumn(chunk, oldHistoryPath, column);
+    exportColumn(chunk, historyPath, column);
+  }
+  if(chunk.used > 0)
+  {
+    chunk.flush();
+  }
+  chunk.flush();
+}
+
+void beginHistory()
+{
+  if(!LittleFS.begin())
+  {
+    Serial.println("History unavailable, LittleFS failed to mount");
+    return;
+  }
+  LittleFS.remove(legacyPath);
+  historyReady = true;
+  if(!addTopicRoute(history_topic, exportHistory))
+  {
+    Serial.println("History is recorded but cannot be exported");
+  }
+}
+
+void historyLoop()
+{
+  unsigned long current = millis();
+  unsigned long elapsed = current - lastSample;
+  lastSample = current;
+  if(!historyReady)
+  {
+    return;
+  }
+
+  if(occupancy.occupied)
+  {
+    occupiedMs += elapsed;
+  }
+  uint8_t count = peopleCounter().count();
+  if(count > peakCount)
+  {
+    peakCount = count;
+  }
+
+  long epoch = epochHour();
+  if(epoch < 0)
+  {
+    return;
+  }
+  uint32_t hour = epoch;
+  if(currentHour == 0)
+  {
+    startHour(hour);
+  }
+  else if(hour != currentHour)
+  {
+    writeSlot(currentHour);
+    startHour(hour);
+  }
+}
@@ -0,0 +1,57 @@
+#include "constants.h"
+
+#define HA_DEVICE \
+  "\"device\":{\"identifiers\":[\"" HA_NODE_ID "\"],\"name\":\"SpottyPottySense\",\"model\":\"ESP8266 PIR\"}," \
+  "\"availability_topic\":\"" HA_AVAILABILITY_TOPIC "\""
+
+// Discovery configs, built by the preprocessor and kept in flash
+static const char occupancyTopic[] = HA_DISCOVERY_PREFIX "/binary_sensor/" HA_NODE_ID "/occupancy/config";
+static const char occupancyConfig[] PROGMEM =
+  "{\"name\":\"Occupancy\",\"unique_id\":\"" HA_NODE_ID "_occupancy\","
+  "\"device_class\":\"occupancy\",\"state_topic\":\"" HA_STATE_TOPIC "\","
+  "\"payload_on\":\"ON\",\"payload_off\":\"OFF\"," HA_DEVICE "}";
+
+static const char peopleTopic[] = HA_DISCOVERY_PREFIX "/sensor/" HA_NODE_ID "/people/config";
+static const char peopleConfig[] PROGMEM =
+  "{\"name\":\"People\",\"unique_id\":\"" HA_NODE_ID "_people\","
+  "\"state_topic\":\"" COUNT_TOPIC "\",\"state_class\":\"measurement\","
+  "\"value_template\":\"{{ value | regex_findall_index('count=(\\\\d+)') }}\"," HA_DEVICE "}";
+
+// Broker the configs were last published to; failover republishes them
+static int discoveryBroker = -1;
+static unsigned long lastAttempt = 0;
+
+void beginHomeAssistant()
+{
+  // Retained like the state published after discovery, so a restarted
+  // Home Assistant always reads the latest state rather than a stale one
+  const char* state = "${occupied?ON:OFF}";
+  setOutput(HA_PAYLOAD_SLOT, (1 << OCCUPANCY_ENTERED) | (1 << OCCUPANCY_VACATED),
+            HA_STATE_TOPIC, strlen(HA_STATE_TOPIC), state, strlen(state), true);
+}
+
+/*
+* Publish the retained discovery configs once per broker, straight from
+* flash, followed by the current state. A failed attempt is retried every
+* HA_DISCOVERY_RETRY_MS rather than on every loop pass.
+*/
+void homeAssistantLoop()
+{
+  if(discoveryBroker == activeBroker() || !client.connected())
+  {
+    return;
+  }
+  if(lastAttempt != 0 && millis() - lastAttempt < HA_DISCOVERY_RETRY_MS)
+  {
+    return;
+  }
+  lastAttempt = millis() | 1;
+
+  if(client.publish_P(occupancyTopic, occupancyConfig, true) &&
+     client.publish_P(peopleTopic, peopleConfig, true))
+  {
+    discoveryBroker = activeBroker();
+    lastAttempt = 0;
+    client.publish(HA_STATE_TOPIC, occupancy.occupied ? "ON" : "OFF", true);
+  }
+}
@@ -0,0 +1,142 @@
+#include "constants.h"
+
+#if IO_RECORDING
+
+#include <LittleFS.h>
+
+static const char* logPath = "/io.log";
+static const char* oldLogPath = "/io.old.log";
+
+static uint8_t logBuffer[IO_LOG_BUFFER_SIZE];
+static IoLogWriter writer;
+static bool fsReady = false;
+static bool clockRecorded = false;
+static unsigned long lastFlush = 0;
+static unsigned long lastUpload = 0;
+
+// Append the RAM buffer to flash; one previous generation is kept on rotation
+static void flushIoLog()
+{
+  lastFlush = millis();
+  if(writer.used == 0 || !fsReady)
+  {
+    writer.used = 0;
+    return;
+  }
+
+  File file = LittleFS.open(logPath, "a");
+  bool full = false;
+  if(file)
+  {
+    file.write(logBuffer, writer.used);
+    full = file.size() > IO_LOG_MAX_BYTES;
+    file.close();
+    if(full)
+    {
+      LittleFS.remove(oldLogPath);
+      LittleFS.rename(logPath, oldLogPath);
+    }
+  }
+  writer.used = 0;
+  if(full)
+  {
+    // The new file must not start with a delta against the old one's last record
+    writer.append(IO_SYNC, writer.lastMs, nullptr, 0);
+  }
+}
+
+void recordInput(IoRecordType type, const void* data, uint8_t length)
+{
+  if(!writer.append(type, millis(), (const uint8_t*)data, length))
+  {
+    flushIoLog();
+    writer.append(type, millis(), (const uint8_t*)data, length);
+  }
+}
+
+static void publishChunk(uint16_t& sequence, const uint8_t* chunk, size_t length)
+{
+  client.beginPublish(io_log_data_topic, 2 + length, false);
+  client.write(sequence >> 8);
+  client.write(sequence & 0xff);
+  client.write(chunk, length);
+  client.endPublish();
+  sequence++;
+}
+
+static void uploadFile(const char* path, uint16_t& sequence)
+{
+  File file = LittleFS.open(path, "r");
+  if(!file)
+  {
+    return;
+  }
+  uint8_t chunk[IO_LOG_CHUNK_SIZE];
+  size_t read;
+  while((read = file.read(chunk, sizeof(chunk))) > 0)
+  {
+    publishChunk(sequence, chunk, read);
+    yield();
+  }
+  file.close();
+}
+
+/*
+* Stream both log generations, /io.old.log then /io.log, to
+* io_log_data_topic in chunks read straight from flash. Each chunk starts
+* with a 16 bit big-endian sequence number; an empty chunk marks the end.
+* The current file starts with an IO_SYNC record, so the concatenation
+* replays as one log.
+*/
+static void uploadIoLog(const char* topic, const byte* payload, unsigned int length)
+{
+  // The upload blocks the loop, so repeated requests must not be able to starve it
+  if(lastUpload != 0 && millis() - lastUpload < IO_LOG_UPLOAD_MIN_INTERVAL_MS)
+  {
+    metrics.rejectedMessages++;
+    return;
+  }
+  lastUpload = millis() | 1;
+
+  flushIoLog();
+  uint16_t sequence = 0;
+  uploadFile(oldLogPath, sequence);
+  uploadFile(logPath, sequence);
+  publishChunk(sequence, nullptr, 0);
+}
+
+void beginIoLog()
+{
+  writer.begin(logBuffer, sizeof(logBuffer));
+  fsReady = LittleFS.begin();
+  if(!fsReady)
+  {
+    Serial.println("Input log unavailable, LittleFS failed to mount");
+  }
+  recordInput(IO_BOOT, nullptr, 0);
+  if(!addTopicRoute(io_log_topic, uploadIoLog))
+  {
+    Serial.println("Input log is recorded but cannot be uploaded");
+  }
+}
+
+void ioLogLoop()
+{
+  if(!clockRecorded)
+  {
+    time_t t = time(nullptr);
+    if(t >= 1600000000)
+    {
+      uint32_t epoch = t;
+      recordInput(IO_CLOCK, &epoch, sizeof(epoch));
+      clockRecorded = true;
+    }
+  }
+
+  if(millis() - lastFlush >= IO_LOG_FLUSH_MS)
+  {
+    flushIoLog();
+  }
+}
+
+#endif // IO_RECORDING
@@ -4,45 +4,215 @@
 WiFiClient espClient;
 PubSubClient client(espClient);
 
-// Checks if motion was detected, sets LED HIGH and starts a timer
-IRAM_ATTR void detectsMovement()
+// Queues an edge with its pulse width. A rising edge is motion: set LED HIGH
+// and flag the event for the loop. Publishing from here would run
+// flash-resident network code in interrupt context, so that is left to
+// handleMotion().
+IRAM_ATTR void recordEdge(uint8_t zone, uint8_t level, unsigned long ms)
 {
-  digitalWrite(led, HIGH);
-  startTimer = true;
-  lastTrigger = millis();
-  Serial.println("Motion DETECTED!!");
-  publish(motion_detect_topic, "Motion Detected in the Bathroom!!!");
+  if(level)
+  {
+    digitalWrite(led, HIGH);
+    room.zoneRise[zone] = ms;
+    room.zoneTrigger[zone] = ms;
+    room.pendingZones |= (uint8_t)(1 << zone);
+    room.lastTrigger = ms;
+    room.edges++;
+    room.motionPending = true;
+    edgeRing.push(ms, 0, zone, HIGH);
+  }
+  else
+  {
+    edgeRing.push(ms, ms - room.zoneRise[zone], zone, LOW);
+  }
+}
+
+// Checks if motion was detected or has ended
+IRAM_ATTR void detectsMovement(void* arg)
+{
+#if ISR_TIMING
+  uint32_t entry = ESP.getCycleCount();
+#endif
+  uint8_t zone = (uint8_t)(uintptr_t)arg;
+  recordEdge(zone, GPIP(zoneSensors[zone]), millis());
+  maskZone(zone);
+#if ISR_TIMING
+  isrTiming.gpio.record(ESP.getCycleCount() - entry);
+#endif
+}
+
+// Feed sensor levels and pulse widths to the occupancy logic. If edges were
+// lost to a full ring, or a faulty sensor stopped being suppressed, resync
+// the levels from the pins.
+void drainEdges()
+{
+  static uint32_t seenOverflows = 0;
+  bool faulted = sensorFaulted();
+  bool resync = !faulted && occupancy.suppressed;
+  occupancy.setSuppressed(faulted, millis());
+
+  EdgeEvent edge;
+  while(edgeRing.pop(edge))
+  {
+    uint8_t record[10];
+    memcpy(record, &edge.ms, 4);
+    memcpy(record + 4, &edge.widthMs, 4);
+    record[8] = edge.zone;
+    record[9] = edge.level;
+    recordInput(IO_EDGE, record, sizeof(record));
+
+    occupancy.onLevel(edge.zone, edge.level, edge.ms);
+    onZoneLevels(occupancy.highSensors, edge.ms);
+    if(!edge.level)
+    {
+      metrics.pulses++;
+      metrics.totalPulseMs += edge.widthMs;
+      if(edge.widthMs > metrics.maxPulseMs)
+      {
+        metrics.maxPulseMs = edge.widthMs;
+      }
+    }
+  }
+
+  if(edgeRing.overflows != seenOverflows)
+  {
+    seenOverflows = edgeRing.overflows;
+    resync = true;
+  }
+  if(resync)
+  {
+    for(int zone = 0; zone < zoneCount; zone++)
+    {
+      occupancy.onLevel(zone, digitalRead(zoneSensors[zone]) == HIGH, millis());
+    }
+    onZoneLevels(occupancy.highSensors, millis());
+  }
+}
+
+// Starts the timer on the first edge and publishes the transition; further
+// edges while the room is occupied are refreshes subject to admission.
+void handleMotion()
+{
+  room.motionPending = false;
+
+  noInterrupts();
+  uint8_t zones = room.pendingZones;
+  room.pendingZones = 0;
+  interrupts();
+
+  uint32_t input[2] = {(uint32_t)room.lastTrigger, (uint32_t)room.edges};
+  recordInput(IO_MOTION, input, sizeof(input));
+
+  // A faulty sensor is reported once through fault_topic, not per edge. Its
+  // edges leave occupancy alone, so a room it would have entered is never
+  // reported vacated without having been reported entered.
+  if(sensorFaulted())
+  {
+    occupancy.handledEdges = input[1];
+    metrics.shed++;
+    return;
+  }
+
+  OccupancyEvent event = occupancy.onMotion(input[0], input[1]);
+  // After onMotion, so the state frame a count change sends already
+  // carries the entry and the transition below finds nothing new to send
+  onZoneMotion(zones);
+  EventClass eventClass = (event == OCCUPANCY_ENTERED) ? EVENT_TRANSITION : EVENT_REFRESH;
+  if(event == OCCUPANCY_ENTERED)
+  {
+    onLocalArrival();
+  }
+
+  if(!admitEvent(eventClass))
+  {
+    return;
+  }
+
+  if(eventClass == EVENT_TRANSITION)
+  {
+    Serial.println("Motion DETECTED!!");
+  }
+  publishEvent(event);
+
+  if(eventClass == EVENT_TRANSITION)
+  {
+    recordTransitionLatency(millis() - occupancy.lastTrigger);
+    reportState();
+  }
 }
 
 void setup() 
 {
+#if BATTERY_PROFILE
+  // Motion pulled RST: report it and go back to deep sleep, no Serial
+  batteryWake();
+#endif
   Serial.begin(115200);
-  // PIR Motion Sensor mode INPUT_PULLUP
-  pinMode(motionSensor, INPUT_PULLUP);
+  beginIoLog();
+  beginDerived();
+  beginEnergy();
+  beginGpioFilter();
+  for(int zone = 0; zone < zoneCount; zone++)
+  {
+    // PIR Motion Sensor mode INPUT_PULLUP
+    pinMode(zoneSensors[zone], INPUT_PULLUP);
 
-  // Set motionSensor pin as interrupt, assign interrupt function and set RISING mode
-  attachInterrupt(digitalPinToInterrupt(motionSensor), detectsMovement, RISING);
+    // Set each zone pin as interrupt, passing the zone to the interrupt function, and set CHANGE mode
+    attachInterruptArg(digitalPinToInterrupt(zoneSensors[zone]), detectsMovement, (void*)(uintptr_t)zone, CHANGE);
+  }
 
   // Set LED to LOW
   pinMode(led, OUTPUT);
   digitalWrite(led, LOW);
 
+  occupancy.begin(timeSeconds * 1000, STUCK_HIGH_MS);
+  beginAdmission();
+  beginSensorHealth();
+  beginSchedule();
+  beginConfig();
+  beginFlow();
+  beginPeopleCount();
+  beginStateReport();
+  beginHistory();
+  beginPayloads();
+  beginHomeAssistant();
+
   connectToWifi();
+  configTime(time_zone, ntp_server);
   setMQTTClient();
 }
 
 void loop()
 {
     WifiConnectionStatus();
+    mqttLoop();
+
+    if(room.motionPending)
+    {
+      handleMotion();
+    }
+    drainEdges();
 
     // Current time
     now = millis();
 
-    // Turn off the LED after the number of seconds defined in the timeSeconds variable
-    if(startTimer && (now - lastTrigger > (timeSeconds*1000))) {
+    // Turn off the LED once every sensor is LOW and the active profile's hold time has passed
+    if(occupancy.tick(now) == OCCUPANCY_VACATED) {
       Serial.println("Motion stopped...");
       digitalWrite(led, LOW);
-      startTimer = false;
+      publishEvent(OCCUPANCY_VACATED);
+      reportState();
     }
-  
-}
\ No newline at end of file
+
+    scheduleLoop();
+    configLoop();
+    ioLogLoop();
+    peopleCountLoop();
+    stateReportLoop();
+    historyLoop();
+    homeAssistantLoop();
+    checkSensorHealth();
+    roamIfNeeded(!occupancy.occupied);
+    energyLoop();
+    reportTelemetry();
+}
@@ -1,15 +1,55 @@
 #include "constants.h"
 
 const char* motion_detect_topic = "motionDetect";
+const char* telemetry_topic = "motionTelemetry";
+const char* fault_topic = "motionFault";
+const char* schedule_topic = "motionSchedule";
+const char* config_topic = "motionConfig";
+const char* config_ack_topic = "motionConfigAck";
+const char* io_log_topic = "motionIoLog";
+const char* io_log_data_topic = "motionIoLogData";
+const char* prediction_topic = "motionPrediction";
+const char* count_topic = COUNT_TOPIC;
+const char* state_topic = "motionState";
+const char* state_ack_topic = "motionStateAck";
+const char* history_topic = "motionHistory";
+const char* history_data_topic = "motionHistoryData";
+const char* template_topic = "motionTemplate";
 
-const char* mqtt_server = "MQTT_SERVER_IP_HERE";
+// NODE_MOTION_TOPIC of the nodes in adjacent rooms, e.g. the corridor
+// outside: "spottypotty/spottypotty_corridor/motion"
+const char* adjacent_topics[FLOW_MAX_SOURCES] = {nullptr};
+
+const char* ntp_server = "pool.ntp.org";
+const char* time_zone = "UTC0";
+
+// Brokers in order of preference; all share the credentials below
+const MqttBroker mqtt_brokers[] = {
+  {"MQTT_SERVER_IP_HERE", 1883},
+};
+const int mqtt_broker_count = sizeof(mqtt_brokers) / sizeof(mqtt_brokers[0]);
 const char* mqtt_user = "MQTT_USER_NAME";
 const char* mqtt_pass = "MQTT_PASSWORD";
-const int mqtt_port = 1883;
 
-const char* ssid = "SSID_HERE";
-const char* password = "PASSWORD_HERE";
+// Known networks, any AP of which may be joined. List the same SSID once.
+const WifiNetwork wifi_networks[] = {
+  {"SSID_HERE", "PASSWORD_HERE"},
+};
+const int wifi_network_count = sizeof(wifi_networks) / sizeof(wifi_networks[0]);
 
 unsigned long now = millis();
-unsigned long lastTrigger = 0;
-boolean startTimer = false;
+volatile RoomState room;
+EdgeRing edgeRing;
+IsrTiming isrTiming;
+Occupancy occupancy;
+PublishMetrics metrics = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+LinkMetrics linkMetrics = {{0}, {0}, {0}, 0, 0, 0, 0, {0}, {0}, 0};
+LinkQuality linkQuality;
+
+// 0: daytime, 1: night (longer hold, sparse reporting, modem sleep)
+NodeProfile profiles[SCHEDULE_PROFILES] = {
+  {timeSeconds * 1000UL, PUBLISH_REFILL_MS, TELEMETRY_INTERVAL_MS, WIFI_NONE_SLEEP},
+  {10000UL, 15000UL, 5UL * TELEMETRY_INTERVAL_MS, WIFI_MODEM_SLEEP},
+};
+const NodeProfile* activeProfile = &profiles[0];
+uint16_t configVersion = 0;
@@ -1,26 +1,331 @@
 #include "constants.h"
 
+// Initialised statically: modules add their routes in setup() before
+// setMQTTClient() runs
+static TopicRoute routeTable[MAX_TOPIC_ROUTES];
+static TopicRouter router = {routeTable, MAX_TOPIC_ROUTES, 0, {}};
 
-void publish(const char* topic_name, const char* message)
+bool addTopicRoute(const char* filter, TopicHandler handler)
 {
-    client.publish(topic_name, message);
+  if(!router.add(filter, handler))
+  {
+    Serial.print("Topic route table full, not subscribed to ");
+    Serial.println(filter);
+    return false;
+  }
+  if(client.connected())
+  {
+    client.subscribe(filter);
+  }
+  return true;
+}
+
+#if IO_RECORDING
+// Topic and payload as one record, [topic length][topic][payload], cut at 255 bytes
+static void recordMessage(const char* topic, const byte* payload, unsigned int length)
+{
+  uint8_t record[255];
+  size_t topicLength = min(strlen(topic), sizeof(record) - 1);
+  record[0] = topicLength;
+  memcpy(record + 1, topic, topicLength);
+  size_t payloadLength = min((size_t)length, sizeof(record) - 1 - topicLength);
+  memcpy(record + 1 + topicLength, payload, payloadLength);
+  recordInput(IO_MQTT_MESSAGE, record, 1 + topicLength + payloadLength);
+}
+#else
+static void recordMessage(const char*, const byte*, unsigned int) {}
+#endif
+
+static void dispatchMessage(char* topic, byte* payload, unsigned int length)
+{
+  recordMessage(topic, payload, length);
+
+  if(length > MQTT_MAX_INBOUND)
+  {
+    metrics.rejectedMessages++;
+    return;
+  }
+
+  router.dispatch(topic, payload, length);
 }
 
+static BrokerSelector brokers;
+static int primaryBroker = -1;
+static bool sessionUp = false;
+static unsigned long downSince = 0;
+
+#if MQTT_DUAL_HOME
+static WiFiClient standbyEspClient;
+static PubSubClient standby(standbyEspClient);
+static int standbyBroker = -1;
+#endif
+
+int activeBroker()
+{
+  return sessionUp ? primaryBroker : -1;
+}
+
+static void applyTrafficClass(TrafficClass trafficClass)
+{
+#if MQTT_TCP_NODELAY
+  espClient.setNoDelay(trafficClass == TRAFFIC_CRITICAL);
+#else
+  espClient.setNoDelay(false);
+#endif
+}
+
+void publish(const char* topic_name, const char* message, TrafficClass trafficClass, bool retained)
+{
+    publish(topic_name, (const uint8_t*)message, strlen(message), trafficClass, retained);
+}
+
+// Binary payloads (state frames) take the same path as text, so they are
+// scored, logged, timed and dual-homed alike
+void publish(const char* topic_name, const uint8_t* payload, unsigned int length, TrafficClass trafficClass,
+             bool retained)
+{
+    applyTrafficClass(trafficClass);
+
+    // A publish on a session that is already down says nothing about the
+    // link, so it is logged but not scored
+    bool live = client.connected();
+
+    enterPhase(PHASE_TX);
+    // Time to hand the packet to the TCP stack; Nagle delays happen after
+    // this returns, so the loopback probe below measures those
+    unsigned long start = micros();
+    bool ok = client.publish(topic_name, payload, length, retained);
+    unsigned long latency = micros() - start;
+    endPhase();
+
+#if MQTT_DUAL_HOME
+    // The receiver drops whichever copy arrives second by its ${seq}
+    if(trafficClass == TRAFFIC_CRITICAL && standby.connected())
+    {
+      standby.publish(topic_name, payload, length, retained);
+    }
+#endif
+
+    int32_t rssi = WiFi.RSSI();
+    uint8_t result[6] = {ok, (uint8_t)(int8_t)rssi,
+                         (uint8_t)(latency >> 24), (uint8_t)(latency >> 16),
+                         (uint8_t)(latency >> 8), (uint8_t)latency};
+    recordInput(IO_PUBLISH_RESULT, result, sizeof(result));
+    if(!live)
+    {
+      return;
+    }
+
+    linkQuality.onPublish(latency, ok, rssi);
+    onLinkChanged();
+
+    int band = rssiBand(rssi);
+    linkMetrics.publishes[band]++;
+    linkMetrics.totalLatencyUs[band] += latency;
+    if(latency > linkMetrics.maxLatencyUs[band])
+    {
+      linkMetrics.maxLatencyUs[band] = latency;
+    }
+}
+
+/*
+* Loopback latency probe. Every LATENCY_PROBE_MS the node publishes to its
+* own probe topic, once as critical and right behind it once as bulk
+* traffic, stamped with micros(). The broker echoes both back, so the
+* round trip includes any time the stack held a segment back. With Nagle
+* on, the bulk probe waits for the critical one to be acknowledged.
+*/
+static bool probeRouted = false;
+static unsigned long lastProbe = 0;
+static uint8_t probesOutstanding = 0;
+
+static void onLatencyProbe(const char* topic, const byte* payload, unsigned int length)
+{
+  char text[16];
+  if(length < 2 || length >= sizeof(text))
+  {
+    return;
+  }
+  memcpy(text, payload, length);
+  text[length] = '\0';
+
+  int trafficClass = text[0] == 'c' ? TRAFFIC_CRITICAL : TRAFFIC_BULK;
+  unsigned long rtt = micros() - strtoul(text + 1, nullptr, 10);
+  probesOutstanding &= ~(1 << trafficClass);
+  linkMetrics.probeRttUs[trafficClass] = rtt;
+  if(rtt > linkMetrics.probeMaxUs[trafficClass])
+  {
+    linkMetrics.probeMaxUs[trafficClass] = rtt;
+  }
+}
+
+static void latencyProbeLoop()
+{
+  // Unanswerable probes would only count as lost
+  if(!probeRouted || millis() - lastProbe < LATENCY_PROBE_MS)
+  {
+    return;
+  }
+  lastProbe = millis();
+
+  // A probe not echoed within a whole interval is counted lost
+  for(uint8_t i = 0; i < 2; i++)
+  {
+    if(probesOutstanding & (1 << i))
+    {
+      linkMetrics.probesLost++;
+    }
+  }
+  probesOutstanding = (1 << TRAFFIC_CRITICAL) | (1 << TRAFFIC_BULK);
+
+  char stamp[16];
+  snprintf(stamp, sizeof(stamp), "c%lu", micros());
+  publish(LATENCY_PROBE_TOPIC, stamp, TRAFFIC_CRITICAL);
+  snprintf(stamp, sizeof(stamp), "b%lu", micros());
+  publish(LATENCY_PROBE_TOPIC, stamp, TRAFFIC_BULK);
+}
+
+static void configureSession(PubSubClient& session, WiFiClient& socket)
+{
+  session.setBufferSize(MQTT_BUFFER_SIZE);
+  session.setKeepAlive(MQTT_KEEPALIVE_S);
+  // A dead broker should fail the read in seconds, not the default 15 s
+  session.setSocketTimeout(MQTT_SOCKET_TIMEOUT_S);
+  // ...and the TCP connect in well under that
+  socket.setTimeout(MQTT_CONNECT_TIMEOUT_MS);
+}
+
+// One bounded connect attempt to the given broker, scored by the selector
+static bool connectSession(PubSubClient& session, WiFiClient& socket, const char* id, int broker)
+{
+  const MqttBroker& target = mqtt_brokers[broker];
+  session.setServer(target.host, target.port);
+
+  enterPhase(PHASE_CONNECT);
+  unsigned long start = millis();
+  // The broker marks the node unavailable for Home Assistant if it drops off
+  bool connected = session.connect(id, mqtt_user, mqtt_pass,
+                                   HA_AVAILABILITY_TOPIC, 0, true, "offline");
+  endPhase();
+  brokers.onConnect(broker, connected, millis() - start, millis());
+  int8_t connectResult[2] = {connected, (int8_t)session.state()};
+  recordInput(IO_MQTT_CONNECT, connectResult, sizeof(connectResult));
+  if(!connected)
+  {
+    Serial.print("Failed to connect to MQTT broker ");
+    Serial.print(target.host);
+    Serial.print(", rc=");
+    Serial.println(session.state());
+    return false;
+  }
+
+  session.publish(HA_AVAILABILITY_TOPIC, "online", true);
+  // TCP keepalive notices a half-open connection between MQTT pings
+  socket.keepAlive(TCP_KEEPALIVE_IDLE_S, TCP_KEEPALIVE_INTERVAL_S, TCP_KEEPALIVE_COUNT);
+  return true;
+}
+
+static void connectPrimary()
+{
+  int broker = brokers.pick(millis(), -1);
+  if(broker < 0 || !connectSession(client, espClient, "ESP8266Client", broker))
+  {
+    return;
+  }
+
+  Serial.print("Connected to MQTT broker ");
+  Serial.println(mqtt_brokers[broker].host);
+  if(downSince != 0)
+  {
+    unsigned long outage = millis() - downSince;
+    linkMetrics.lastOutageMs = outage;
+    if(outage > linkMetrics.maxOutageMs)
+    {
+      linkMetrics.maxOutageMs = outage;
+    }
+    if(broker != primaryBroker)
+    {
+      linkMetrics.failovers++;
+    }
+  }
+  primaryBroker = broker;
+  sessionUp = true;
+
+  applyTrafficClass(TRAFFIC_CRITICAL);
+  for(uint8_t i = 0; i < router.count; i++)
+  {
+    client.subscribe(router.routes[i].filter);
+  }
+}
+
+#if MQTT_DUAL_HOME
+// Keep the standby session on a different broker than the primary
+static void standbyLoop()
+{
+  if(standby.connected() && standbyBroker == primaryBroker)
+  {
+    standby.disconnect();
+  }
+  if(!standby.connected())
+  {
+    int broker = brokers.pick(millis(), primaryBroker);
+    if(broker < 0 || !connectSession(standby, standbyEspClient, "ESP8266ClientStandby", broker))
+    {
+      return;
+    }
+    standbyBroker = broker;
+    standbyEspClient.setNoDelay(MQTT_TCP_NODELAY);
+  }
+  standby.loop();
+}
+#endif
+
 void setMQTTClient()
 {
-  client.setServer(mqtt_server, mqtt_port);
-  while (!client.connected()) 
+  brokers.begin(mqtt_broker_count, MQTT_RETRY_MS, MQTT_RETRY_MAX_MS);
+  client.setCallback(dispatchMessage);
+  configureSession(client, espClient);
+#if MQTT_DUAL_HOME
+  configureSession(standby, standbyEspClient);
+#endif
+  probeRouted = addTopicRoute(LATENCY_PROBE_TOPIC, onLatencyProbe);
+  connectPrimary();
+}
+
+/*
+* Keep the MQTT session alive and deliver incoming messages to their routes.
+* A lost session is retried on the healthiest broker, one attempt per pass.
+* While the primary is down an open standby is still serviced, so critical
+* publishes keep reaching it; it is only reconnected alongside a live
+* primary, which keeps to one connect attempt per pass.
+*/
+void mqttLoop()
+{
+  if(!client.connected())
   {
-    if (client.connect("ESP8266Client", mqtt_user, mqtt_pass)) 
+#if MQTT_DUAL_HOME
+    if(standby.connected())
+    {
+      standby.loop();
+    }
+#endif
+    if(sessionUp)
     {
-      Serial.println("Connected to MQTT broker");
-    } 
-    else 
+      Serial.println("MQTT disconnected!! Trying to Connect Again");
+      sessionUp = false;
+      downSince = millis();
+      brokers.onDrop(primaryBroker, millis());
+    }
+    // Without WiFi every attempt would fail and wrongly mark brokers down
+    if(WiFi.status() == WL_CONNECTED)
     {
-      Serial.print("Failed to connect to MQTT broker, rc=");
-      Serial.print(client.state());
-      Serial.println(" Retrying in 5 seconds...");
-      delay(5000);
+      connectPrimary();
     }
+    return;
   }
-}
\ No newline at end of file
+  client.loop();
+  latencyProbeLoop();
+#if MQTT_DUAL_HOME
+  standbyLoop();
+#endif
+}
@@ -0,0 +1,171 @@
+#include "constants.h"
+
+static const char* const fieldNames[PAYLOAD_FIELDS] = {
+  "occupied", "event", "count", "low", "zones", "uptime", "config", "seq"
+};
+
+struct PayloadOutput
+{
+  uint8_t events;
+  bool retained;
+  char topic[PAYLOAD_TOPIC_SIZE];
+  PayloadTemplate format;
+};
+
+static PayloadOutput outputs[PAYLOAD_OUTPUTS];
+
+// Numbers each published event so a receiver can drop duplicates
+static uint32_t eventSequence = 0;
+
+static uint8_t eventBit(OccupancyEvent event)
+{
+  return (uint8_t)(1 << event);
+}
+
+static uint8_t parseEvents(const char* text, uint32_t length)
+{
+  uint8_t events = 0;
+  for(uint32_t i = 0; i < length; i++)
+  {
+    if(text[i] == 'e') events |= eventBit(OCCUPANCY_ENTERED);
+    if(text[i] == 'r') events |= eventBit(OCCUPANCY_REFRESHED);
+    if(text[i] == 'v') events |= eventBit(OCCUPANCY_VACATED);
+  }
+  return events;
+}
+
+// Compile into a scratch output first so a bad template leaves the slot as it was
+bool setOutput(uint8_t slot, uint8_t events, const char* topic, uint32_t topicLength,
+               const char* source, uint32_t sourceLength, bool retained)
+{
+  if(slot >= PAYLOAD_OUTPUTS || topicLength >= PAYLOAD_TOPIC_SIZE)
+  {
+    return false;
+  }
+  PayloadOutput& output = outputs[slot];
+  if(sourceLength == 0)
+  {
+    output.events = 0;
+    return true;
+  }
+
+  // A publish topic must be concrete, and an output must fire on something
+  if(topicLength == 0 || memchr(topic, '+', topicLength) || memchr(topic, '#', topicLength) ||
+     memchr(topic, '\0', topicLength) || events == 0)
+  {
+    return false;
+  }
+
+  static PayloadOutput staged;
+  if(!staged.format.compile(source, sourceLength, fieldNames, PAYLOAD_FIELDS))
+  {
+    return false;
+  }
+  staged.events = events;
+  staged.retained = retained;
+  memcpy(staged.topic, topic, topicLength);
+  staged.topic[topicLength] = '\0';
+  output = staged;
+  return true;
+}
+
+static void onTemplateMessage(const char* topic, const byte* payload, unsigned int length)
+{
+  const char* text = (const char*)payload;
+  const char* parts[4];
+  uint32_t lengths[4];
+  uint32_t start = 0;
+  for(int part = 0; part < 4; part++)
+  {
+    uint32_t end = start;
+    while(end < length && (part == 3 || text[end] != '\n'))
+    {
+      end++;
+    }
+    if(part < 3 && end == length)
+    {
+      metrics.rejectedMessages++;
+      return;
+    }
+    parts[part] = text + start;
+    lengths[part] = end - start;
+    start = end + 1;
+  }
+
+  // A new template keeps the slot's retain flag, so a retemplated state
+  // topic is still retained on every update
+  uint8_t slot = parts[0][0] - '0';
+  if(lengths[0] != 1 || parts[0][0] < '0' || parts[0][0] > '9' ||
+     !setOutput(slot, parseEvents(parts[1], lengths[1]), parts[2], lengths[2], parts[3], lengths[3],
+                slot < PAYLOAD_OUTPUTS && outputs[slot].retained))
+  {
+    Serial.println("Rejected payload template");
+    metrics.rejectedMessages++;
+  }
+}
+
+#if MQTT_DUAL_HOME
+// Critical events reach both brokers; the receiver drops the second copy by
+// its sequence number. The HA state is plain ON/OFF and a repeat is harmless.
+#define DUAL_HOME_SEQ " seq=${seq}"
+#else
+#define DUAL_HOME_SEQ ""
+#endif
+
+void beginPayloads()
+{
+  // Slot 0 keeps the original message for the Spotify bridge
+  const char* legacy = "Motion Detected in the Bathroom!!!" DUAL_HOME_SEQ;
+  setOutput(0, eventBit(OCCUPANCY_ENTERED) | eventBit(OCCUPANCY_REFRESHED),
+            motion_detect_topic, strlen(motion_detect_topic), legacy, strlen(legacy));
+  // Per-node motion, for neighbours to tell this node's motion from their own
+  const char* motion = "${event}" DUAL_HOME_SEQ;
+  setOutput(NODE_MOTION_SLOT, eventBit(OCCUPANCY_ENTERED) | eventBit(OCCUPANCY_REFRESHED),
+            NODE_MOTION_TOPIC, strlen(NODE_MOTION_TOPIC), motion, strlen(motion));
+  if(!addTopicRoute(template_topic, onTemplateMessage))
+  {
+    Serial.println("Payload templates are fixed to the built-in ones");
+  }
+}
+
+/*
+* Render and publish every output subscribed to this event
+*/
+void publishEvent(OccupancyEvent event)
+{
+  const PeopleCounter& counter = peopleCounter();
+  uint32_t values[PAYLOAD_FIELDS];
+  values[PAYLOAD_OCCUPIED] = occupancy.occupied;
+  values[PAYLOAD_EVENT] = event;
+  values[PAYLOAD_COUNT] = counter.count();
+  values[PAYLOAD_COUNT_LOW] = counter.low(millis());
+  values[PAYLOAD_ZONES] = counter.active;
+  values[PAYLOAD_UPTIME_MS] = millis();
+  values[PAYLOAD_CONFIG] = configVersion;
+  values[PAYLOAD_SEQ] = ++eventSequence;
+
+  char message[PAYLOAD_SIZE];
+  for(int slot = 0; slot < PAYLOAD_OUTPUTS; slot++)
+  {
+    const PayloadOutput& output = outputs[slot];
+    if(!(output.events & eventBit(event)))
+    {
+      continue;
+    }
+
+    unsigned long start = micros();
+    uint32_t length = output.format.render(values, message, sizeof(message));
+    unsigned long elapsed = micros() - start;
+    metrics.renders++;
+    metrics.totalRenderUs += elapsed;
+    if(elapsed > metrics.maxRenderUs)
+    {
+      metrics.maxRenderUs = elapsed;
+    }
+
+    if(length > 0)
+    {
+      publish(output.topic, message, TRAFFIC_CRITICAL, output.retained);
+    }
+  }
+}
@@ -0,0 +1,75 @@
+#include "constants.h"
+
+static PeopleCounter counter;
+
+static void reportCount()
+{
+  uint32_t current = millis();
+  char message[40];
+  snprintf(message, sizeof(message), "count=%u,low=%u,high=%u",
+           counter.count(), counter.low(current), counter.count());
+  publish(count_topic, message);
+  reportState();
+}
+
+void beginPeopleCount()
+{
+  counter.begin(zoneCount, activeProfile->holdMs);
+}
+
+/*
+* Feed the zones that fired since the last call, as a bitmask
+*/
+void onZoneMotion(uint8_t zones)
+{
+  bool changed = false;
+  for(uint8_t zone = 0; zones; zone++, zones >>= 1)
+  {
+    if(zones & 1)
+    {
+      changed |= counter.onZoneMotion(zone, room.zoneTrigger[zone]);
+    }
+  }
+  if(changed)
+  {
+    reportCount();
+  }
+}
+
+/*
+* Zone levels as the occupancy machine sees them, so a suppressed or stuck
+* sensor stops holding a zone exactly when it stops holding the room
+*/
+void onZoneLevels(uint8_t highZones, uint32_t ms)
+{
+  uint8_t changed = counter.high ^ highZones;
+  bool counted = false;
+  for(uint8_t zone = 0; changed; zone++, changed >>= 1)
+  {
+    if(changed & 1)
+    {
+      counted |= counter.onLevel(zone, highZones & (1 << zone), ms);
+    }
+  }
+  if(counted)
+  {
+    reportCount();
+  }
+}
+
+void peopleCountLoop()
+{
+  // Zones hold for as long as the room does under the active profile
+  counter.holdMs = activeProfile->holdMs;
+  // Occupancy drops a stuck sensor on its own tick, without an edge
+  onZoneLevels(occupancy.highSensors, millis());
+  if(counter.tick(millis()))
+  {
+    reportCount();
+  }
+}
+
+const PeopleCounter& peopleCounter()
+{
+  return counter;
+}
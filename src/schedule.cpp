@@ -0,0 +1,82 @@
+#include "constants.h"
+
+static Schedule schedule;
+static uint8_t activeIndex = 0;
+static unsigned long nextCheck = 0;
+static unsigned long checkDelay = 0;
+
+static void applyProfile(uint8_t index)
+{
+  activeIndex = index;
+  activeProfile = &profiles[index];
+
+  occupancy.holdMs = activeProfile->holdMs;
+  setRefreshPeriod(activeProfile->refreshMs);
+  onProfileChanged();
+  WiFi.setSleepMode(activeProfile->sleepMode);
+
+  Serial.print("Schedule profile ");
+  Serial.println(index);
+}
+
+// Pick the profile for the current time and work out when the next switch
+// is due, so scheduleLoop() only compares one timestamp until then.
+static void evaluateSchedule()
+{
+  nextCheck = millis();
+  time_t t = time(nullptr);
+  if(t < 1600000000)
+  {
+    checkDelay = SCHEDULE_CLOCK_RETRY_MS;
+    return;
+  }
+  struct tm local;
+  localtime_r(&t, &local);
+  uint32_t secondOfDay = local.tm_hour * 3600UL + local.tm_min * 60UL + local.tm_sec;
+
+  uint8_t index = schedule.profileAt(secondOfDay);
+  if(index != activeIndex)
+  {
+    applyProfile(index);
+  }
+  checkDelay = schedule.secondsUntilNext(secondOfDay) * 1000UL;
+}
+
+static void onScheduleMessage(const char* topic, const byte* payload, unsigned int length)
+{
+  if(!schedule.parse(payload, length, SCHEDULE_PROFILES))
+  {
+    Serial.println("Rejected schedule update");
+    return;
+  }
+  Serial.println("Schedule updated");
+  evaluateSchedule();
+}
+
+void beginSchedule()
+{
+  const char* table = SCHEDULE_DEFAULT;
+  schedule.parse((const uint8_t*)table, strlen(table), SCHEDULE_PROFILES);
+  applyProfile(0);
+  if(!addTopicRoute(schedule_topic, onScheduleMessage))
+  {
+    Serial.println("Schedule is fixed to " SCHEDULE_DEFAULT);
+  }
+  evaluateSchedule();
+}
+
+/*
+* Re-apply the active profile after its fields changed
+*/
+void refreshProfile()
+{
+  applyProfile(activeIndex);
+}
+
+void scheduleLoop()
+{
+  if(millis() - nextCheck >= checkDelay)
+  {
+    evaluateSchedule();
+  }
+}
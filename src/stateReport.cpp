@@ -0,0 +1,142 @@
+#include "constants.h"
+
+struct StateSnapshot
+{
+  uint16_t seq;
+  uint32_t fields[STATE_MAX_FIELDS];
+};
+
+static uint32_t state[STATE_MAX_FIELDS];
+static uint8_t fieldCount = 0;
+
+// Recently sent states, so an ack can promote one to the delta base
+static StateSnapshot sent[STATE_HISTORY];
+static uint8_t sentNext = 0;
+static StateSnapshot acked;
+static bool haveAcked = false;
+
+static uint16_t sequence = 0;
+static unsigned long lastKeyframe = 0;
+static unsigned long lastAccumulate = 0;
+static unsigned long entries = 0;
+
+// Fold elapsed time into the room and zone duration counters
+static void accumulate()
+{
+  unsigned long current = millis();
+  unsigned long elapsed = (current - lastAccumulate) / 1000;
+  if(elapsed == 0)
+  {
+    return;
+  }
+  lastAccumulate += elapsed * 1000;
+
+  if(state[STATE_OCCUPIED])
+  {
+    state[STATE_OCCUPIED_SECONDS] += elapsed;
+  }
+  for(int zone = 0; zone < zoneCount; zone++)
+  {
+    if(state[STATE_ZONES] & (1 << zone))
+    {
+      state[STATE_ZONE_SECONDS + zone] += elapsed;
+    }
+  }
+}
+
+static void sample()
+{
+  accumulate();
+  const PeopleCounter& counter = peopleCounter();
+
+  if(occupancy.occupied && !state[STATE_OCCUPIED])
+  {
+    entries++;
+  }
+  state[STATE_OCCUPIED] = occupancy.occupied;
+  state[STATE_ZONES] = counter.active;
+  state[STATE_COUNT] = counter.count();
+  state[STATE_COUNT_LOW] = counter.low(millis());
+  state[STATE_ENTRIES] = entries;
+}
+
+static void sendFrame(bool keyframe)
+{
+  uint8_t frame[STATE_FRAME_SIZE];
+  sequence++;
+  uint32_t length = encodeStateFrame(frame, sizeof(frame), sequence,
+                                     keyframe ? nullptr : acked.fields, acked.seq,
+                                     state, fieldCount);
+  if(length == 0)
+  {
+    return;
+  }
+  publish(state_topic, frame, length);
+  metrics.stateBytes += length;
+
+  StateSnapshot& slot = sent[sentNext];
+  sentNext = (sentNext + 1) % STATE_HISTORY;
+  slot.seq = sequence;
+  memcpy(slot.fields, state, sizeof(state));
+
+  if(keyframe)
+  {
+    lastKeyframe = millis();
+  }
+}
+
+static void onStateAck(const char* topic, const byte* payload, unsigned int length)
+{
+  if(length != 2)
+  {
+    return;
+  }
+  uint16_t seq = (payload[0] << 8) | payload[1];
+  for(int i = 0; i < STATE_HISTORY; i++)
+  {
+    if(seq != 0 && sent[i].seq == seq)
+    {
+      acked = sent[i];
+      haveAcked = true;
+      return;
+    }
+  }
+}
+
+void beginStateReport()
+{
+  fieldCount = STATE_ZONE_SECONDS + zoneCount;
+  lastAccumulate = millis();
+  // First loop sends a keyframe
+  lastKeyframe = millis() - STATE_KEYFRAME_MS;
+  // Without acks every frame is a keyframe
+  if(!addTopicRoute(state_ack_topic, onStateAck))
+  {
+    Serial.println("State acks will not be received");
+  }
+}
+
+/*
+* Publish the state vector if it changed since the last report
+*/
+void reportState()
+{
+  // Durations tick on their own; only the other fields trigger a report
+  uint32_t previous[STATE_OCCUPIED_SECONDS];
+  memcpy(previous, state, sizeof(previous));
+  sample();
+  if(memcmp(previous, state, sizeof(previous)) == 0)
+  {
+    return;
+  }
+  sendFrame(!haveAcked);
+}
+
+void stateReportLoop()
+{
+  if(millis() - lastKeyframe >= STATE_KEYFRAME_MS)
+  {
+    sample();
+    sendFrame(true);
+  }
+}
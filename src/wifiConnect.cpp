@@ -1,12 +1,76 @@
 #include "constants.h"
 
+static unsigned long lastRoamScan = 0;
+// Start of a roam join in progress, 0 when none
+static unsigned long roamStarted = 0;
+static uint8_t lastStatus = WL_IDLE_STATUS;
+
+int rssiBand(int32_t rssi)
+{
+  if(rssi >= -60) return 0;
+  if(rssi >= -70) return 1;
+  if(rssi >= -80) return 2;
+  return 3;
+}
+
+static int findNetwork(const String& ssid)
+{
+  for(int i = 0; i < wifi_network_count; i++)
+  {
+    if(ssid == wifi_networks[i].ssid)
+    {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// Strongest scan result belonging to a known network, or -1
+static int strongestKnownAP(int found)
+{
+  int best = -1;
+  for(int i = 0; i < found; i++)
+  {
+    if(findNetwork(WiFi.SSID(i)) >= 0 && (best < 0 || WiFi.RSSI(i) > WiFi.RSSI(best)))
+    {
+      best = i;
+    }
+  }
+  return best;
+}
+
+static void beginOnAP(int scanIndex)
+{
+  const WifiNetwork& network = wifi_networks[findNetwork(WiFi.SSID(scanIndex))];
+  Serial.print("Joining ");
+  Serial.print(network.ssid);
+  Serial.print(" at ");
+  Serial.print(WiFi.RSSI(scanIndex));
+  Serial.println(" dBm");
+  WiFi.begin(network.ssid, network.password, WiFi.channel(scanIndex), WiFi.BSSID(scanIndex));
+}
+
 /*
 * Connect your controller to WiFi
 */
 void connectToWifi()
 {
   Serial.println("Connecting to WiFi...");
-  WiFi.begin(ssid, password);
+  enterPhase(PHASE_CONNECT);
+
+  // Pick the strongest AP of any known network rather than whichever the SDK finds first
+  int found = WiFi.scanNetworks();
+  int best = strongestKnownAP(found);
+  if(best >= 0)
+  {
+    beginOnAP(best);
+  }
+  else
+  {
+    // Nothing visible in the scan (hidden SSID?), let the SDK try the first network
+    WiFi.begin(wifi_networks[0].ssid, wifi_networks[0].password);
+  }
+  WiFi.scanDelete();
   int retries = 0;
 
   while((WiFi.status() != WL_CONNECTED) && (retries < 15))
@@ -26,10 +90,40 @@ void connectToWifi()
     Serial.print("IP address: ");
     Serial.println(WiFi.localIP());
   }
+  endPhase();
 }
 
 void WifiConnectionStatus()
 {
+    uint8_t status = WiFi.status();
+    if(status != lastStatus)
+    {
+      lastStatus = status;
+      recordInput(IO_WIFI_STATUS, &status, 1);
+    }
+
+    // A roam join is left to finish on its own; only one that has not
+    // connected by its deadline falls back to the full reconnect
+    if(roamStarted != 0)
+    {
+      if(status == WL_CONNECTED)
+      {
+        roamStarted = 0;
+        Serial.print("Roamed, now at ");
+        Serial.print(WiFi.RSSI());
+        Serial.println(" dBm");
+      }
+      else if(millis() - roamStarted < ROAM_JOIN_TIMEOUT_MS)
+      {
+        return;
+      }
+      else
+      {
+        roamStarted = 0;
+        Serial.println("Roam join timed out");
+      }
+    }
+
     // Check WiFi connection
     if((WiFi.status() != WL_CONNECTED))
     {
@@ -48,3 +142,42 @@ void WifiConnectionStatus()
     }
 
 }
+
+/*
+* Proactive roaming. Scans only run while the room is idle so they never
+* delay an occupancy publish; the scan itself is asynchronous.
+*/
+void roamIfNeeded(bool idle)
+{
+  int found = WiFi.scanComplete();
+  if(found == WIFI_SCAN_RUNNING)
+  {
+    return;
+  }
+
+  if(found >= 0)
+  {
+    int best = strongestKnownAP(found);
+    int32_t current = WiFi.RSSI();
+    if(idle && best >= 0 && WiFi.RSSI(best) >= current + ROAM_RSSI_MARGIN &&
+       memcmp(WiFi.BSSID(best), WiFi.BSSID(), 6) != 0)
+    {
+      Serial.print("Roaming away from AP at ");
+      Serial.print(current);
+      Serial.println(" dBm");
+      beginOnAP(best);
+      roamStarted = millis() | 1;
+      linkMetrics.roams++;
+    }
+    WiFi.scanDelete();
+    return;
+  }
+
+  if(!idle || WiFi.status() != WL_CONNECTED || WiFi.RSSI() >= ROAM_RSSI_THRESHOLD ||
+     millis() - lastRoamScan < ROAM_SCAN_INTERVAL_MS)
+  {
+    return;
+  }
+  lastRoamScan = millis();
+  WiFi.scanNetworks(true);
+}
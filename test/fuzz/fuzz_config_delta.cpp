@@ -0,0 +1,22 @@
+#include <stdlib.h>
+#include <SpottyCore.h>
+
+// ConfigDelta::parse as fed from config_topic
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+  ConfigDelta delta;
+  if(!delta.parse(data, size))
+  {
+    return 0;
+  }
+  if(delta.type == CONFIG_DELTA_APPLY &&
+     (delta.count > CONFIG_DELTA_MAX_ENTRIES || size != 6 + 5u * delta.count))
+  {
+    abort();
+  }
+  if(delta.type == CONFIG_DELTA_ROLLBACK && size != 3)
+  {
+    abort();
+  }
+  return 0;
+}
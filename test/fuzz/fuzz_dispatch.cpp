@@ -0,0 +1,71 @@
+#include <stdlib.h>
+#include <string.h>
+#include <SpottyCore.h>
+
+/*
+* Inbound MQTT dispatch. Input is [topic length][topic][payload]; the topic
+* is handed over NUL-terminated as PubSubClient does. The routes are the
+* firmware's own filters plus wildcard ones, and the router is kept across
+* inputs so its resolution cache is exercised too.
+*/
+#define MQTT_MAX_INBOUND 128
+
+static const char* delivered;
+static unsigned int deliveredLength;
+
+static void handler(const char* topic, const uint8_t* payload, unsigned int length)
+{
+  delivered = topic;
+  deliveredLength = length;
+  if(length > MQTT_MAX_INBOUND)
+  {
+    abort();
+  }
+}
+
+static const char* const filters[] = {
+  "motionIoLog", "motionConfig", "motionSchedule", "motionStateAck", "motionHistory",
+  "motionTemplate", "spottypotty/spottypotty_bathroom/probe", "corridor/+/motion", "hall/#"
+};
+#define FILTER_COUNT (sizeof(filters) / sizeof(filters[0]))
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+  static TopicRoute table[FILTER_COUNT];
+  static TopicRouter router;
+  if(router.capacity == 0)
+  {
+    router.begin(table, FILTER_COUNT);
+    for(uint32_t i = 0; i < FILTER_COUNT; i++)
+    {
+      router.add(filters[i], handler);
+    }
+  }
+  if(size == 0)
+  {
+    return 0;
+  }
+
+  size_t topicLength = data[0] < size - 1 ? data[0] : size - 1;
+  char topic[256];
+  memcpy(topic, data + 1, topicLength);
+  topic[topicLength] = '\0';
+  unsigned int length = size - 1 - topicLength;
+  if(length > MQTT_MAX_INBOUND)
+  {
+    return 0;
+  }
+
+  delivered = nullptr;
+  bool routed = router.dispatch(topic, data + 1 + topicLength, length);
+  bool matches = false;
+  for(uint32_t i = 0; i < FILTER_COUNT; i++)
+  {
+    matches = matches || topicMatches(filters[i], topic);
+  }
+  if(routed != matches || (routed && (delivered != topic || deliveredLength != length)))
+  {
+    abort();
+  }
+  return 0;
+}
@@ -0,0 +1,46 @@
+#include <stdlib.h>
+#include <string.h>
+#include <SpottyCore.h>
+
+/*
+* IoLogReader::next over an arbitrary (uploaded, possibly truncated) log.
+* Every record read is written back with IoLogWriter and must read back
+* the same.
+*/
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+  static uint8_t copy[4096];
+  IoLogWriter writer;
+  writer.begin(copy, sizeof(copy));
+
+  IoLogReader reader;
+  reader.begin(data, size);
+  IoRecord record;
+  while(reader.next(record))
+  {
+    if(record.data < data || record.data + record.length > data + size)
+    {
+      abort();
+    }
+    // IO_BOOT and IO_SYNC are absolute, everything else is a delta
+    if(!writer.append(record.type, record.ms, record.data, record.length))
+    {
+      break;
+    }
+  }
+
+  IoLogReader original;
+  original.begin(data, size);
+  IoLogReader rewritten;
+  rewritten.begin(copy, writer.used);
+  IoRecord expected;
+  while(rewritten.next(record))
+  {
+    if(!original.next(expected) || expected.type != record.type || expected.ms != record.ms ||
+       expected.length != record.length || memcmp(expected.data, record.data, record.length) != 0)
+    {
+      abort();
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,42 @@
+#include <stdlib.h>
+#include <string.h>
+#include <SpottyCore.h>
+
+// The firmware's field names, see src/payloads.cpp
+static const char* const fieldNames[] = {
+  "occupied", "event", "count", "low", "zones", "uptime", "config", "seq"
+};
+#define FIELD_COUNT (sizeof(fieldNames) / sizeof(fieldNames[0]))
+
+// PayloadTemplate::compile as fed from template_topic, then render into short buffers
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+  PayloadTemplate format;
+  if(!format.compile((const char*)data, size, fieldNames, FIELD_COUNT))
+  {
+    return 0;
+  }
+  uint32_t values[FIELD_COUNT];
+  for(uint32_t i = 0; i < FIELD_COUNT; i++)
+  {
+    values[i] = i & 1 ? 0xffffffff : 0;
+  }
+  char out[160];
+  for(uint32_t capacity = 1; capacity <= sizeof(out); capacity += 13)
+  {
+    memset(out, 0x55, sizeof(out));
+    uint32_t length = format.render(values, out, capacity);
+    if(length >= capacity || (length && strlen(out) != length))
+    {
+      abort();
+    }
+    for(uint32_t i = capacity; i < sizeof(out); i++)
+    {
+      if(out[i] != 0x55)
+      {
+        abort();
+      }
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,28 @@
+#include <stdlib.h>
+#include <SpottyCore.h>
+
+// Schedule::parse as fed from schedule_topic, with the firmware's two profiles
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+  Schedule schedule = {};
+  if(!schedule.parse(data, size, 2))
+  {
+    if(schedule.count != 0)
+    {
+      abort();
+    }
+    return 0;
+  }
+  if(schedule.count == 0 || schedule.count > SCHEDULE_MAX_ENTRIES)
+  {
+    abort();
+  }
+  for(uint32_t second = 0; second < 86400; second += 3599)
+  {
+    if(schedule.profileAt(second) >= 2 || schedule.secondsUntilNext(second) > 86400)
+    {
+      abort();
+    }
+  }
+  return 0;
+}
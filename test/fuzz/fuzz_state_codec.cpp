@@ -0,0 +1,46 @@
+#include <stdlib.h>
+#include <string.h>
+#include <SpottyCore.h>
+
+/*
+* decodeStateFrame on arbitrary frames. The first STATE_MAX_FIELDS bytes
+* seed the receiver's base state; a frame that decodes must re-encode to a
+* frame that decodes to the same fields.
+*/
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+  uint32_t base[STATE_MAX_FIELDS] = {0};
+  size_t seed = size < STATE_MAX_FIELDS ? size : STATE_MAX_FIELDS;
+  for(size_t i = 0; i < seed; i++)
+  {
+    base[i] = data[i] * 0x01010101u;
+  }
+  data += seed;
+  size -= seed;
+
+  uint32_t fields[STATE_MAX_FIELDS];
+  uint16_t seq, baseSeq;
+  uint8_t count;
+  if(!decodeStateFrame(data, size, seq, baseSeq, base, fields, count))
+  {
+    return 0;
+  }
+  if(count > STATE_MAX_FIELDS)
+  {
+    abort();
+  }
+
+  bool delta = data[0] == STATE_DELTA;
+  uint8_t frame[6 + STATE_MAX_FIELDS * 12];
+  uint32_t length = encodeStateFrame(frame, sizeof(frame), seq, delta ? base : nullptr, baseSeq, fields, count);
+  uint32_t decoded[STATE_MAX_FIELDS];
+  uint16_t seq2, baseSeq2;
+  uint8_t count2;
+  if(length == 0 || !decodeStateFrame(frame, length, seq2, baseSeq2, base, decoded, count2) ||
+     seq2 != seq || baseSeq2 != baseSeq || count2 != count ||
+     memcmp(decoded, fields, count * sizeof(uint32_t)) != 0)
+  {
+    abort();
+  }
+  return 0;
+}
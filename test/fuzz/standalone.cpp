@@ -0,0 +1,142 @@
+/*
+* Driver for compilers without libFuzzer. Runs every file in the given
+* corpus directories through LLVMFuzzerTestOneInput, then -runs=N random
+* mutations of them, and reports executions per second. No coverage
+* feedback, so it finds less than libFuzzer; it is for replaying crashes,
+* smoke runs in CI and comparing parser speed.
+*
+*   ./fuzz_schedule [-runs=N] [-seed=S] corpus/schedule
+*/
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <stdint.h>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+typedef std::vector<uint8_t> Input;
+
+static void readFile(const char* path, std::vector<Input>& inputs)
+{
+  FILE* file = fopen(path, "rb");
+  if(!file)
+  {
+    return;
+  }
+  Input input;
+  int c;
+  while((c = fgetc(file)) != EOF)
+  {
+    input.push_back((uint8_t)c);
+  }
+  fclose(file);
+  inputs.push_back(input);
+}
+
+static void readCorpus(const char* path, std::vector<Input>& inputs)
+{
+  DIR* dir = opendir(path);
+  if(!dir)
+  {
+    readFile(path, inputs);
+    return;
+  }
+  struct dirent* entry;
+  while((entry = readdir(dir)) != nullptr)
+  {
+    if(entry->d_name[0] == '.')
+    {
+      continue;
+    }
+    char file[1024];
+    snprintf(file, sizeof(file), "%s/%s", path, entry->d_name);
+    readFile(file, inputs);
+  }
+  closedir(dir);
+}
+
+static void mutate(Input& input)
+{
+  int edits = 1 + rand() % 4;
+  for(int i = 0; i < edits; i++)
+  {
+    size_t at = input.empty() ? 0 : rand() % input.size();
+    switch(rand() % 5)
+    {
+      case 0:
+        if(!input.empty())
+        {
+          input[at] ^= 1 << (rand() % 8);
+        }
+        break;
+      case 1:
+        if(!input.empty())
+        {
+          input[at] = (uint8_t)rand();
+        }
+        break;
+      case 2:
+        input.insert(input.begin() + at, (uint8_t)rand());
+        break;
+      case 3:
+        if(!input.empty())
+        {
+          input.erase(input.begin() + at);
+        }
+        break;
+      default:
+        input.resize(at);
+        break;
+    }
+  }
+}
+
+int main(int argc, char** argv)
+{
+  long runs = 100000;
+  unsigned seed = (unsigned)time(nullptr);
+  std::vector<Input> corpus;
+  for(int i = 1; i < argc; i++)
+  {
+    if(strncmp(argv[i], "-runs=", 6) == 0)
+    {
+      runs = atol(argv[i] + 6);
+    }
+    else if(strncmp(argv[i], "-seed=", 6) == 0)
+    {
+      seed = (unsigned)atol(argv[i] + 6);
+    }
+    else if(argv[i][0] != '-')
+    {
+      readCorpus(argv[i], corpus);
+    }
+  }
+  if(corpus.empty())
+  {
+    corpus.push_back(Input());
+  }
+  srand(seed);
+
+  for(const Input& input : corpus)
+  {
+    LLVMFuzzerTestOneInput(input.data(), input.size());
+  }
+
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for(long run = 0; run < runs; run++)
+  {
+    Input input = corpus[rand() % corpus.size()];
+    mutate(input);
+    LLVMFuzzerTestOneInput(input.data(), input.size());
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+  printf("%s: %zu corpus inputs, %ld runs, seed %u, %.0f exec/s\n",
+         argv[0], corpus.size(), runs, seed, seconds > 0 ? runs / seconds : 0.0);
+  return 0;
+}
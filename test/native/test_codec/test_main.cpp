@@ -0,0 +1,134 @@
+#include <unity.h>
+#include <SpottyCore.h>
+
+void setUp() {}
+void tearDown() {}
+
+static void test_state_keyframe_round_trips()
+{
+  uint32_t fields[4] = {1, 0, 300, 0xffffffff};
+  uint8_t frame[32];
+  uint32_t length = encodeStateFrame(frame, sizeof(frame), 7, nullptr, 0, fields, 4);
+  TEST_ASSERT_TRUE(length > 0);
+
+  uint32_t decoded[STATE_MAX_FIELDS];
+  uint16_t seq, baseSeq;
+  uint8_t count;
+  TEST_ASSERT_TRUE(decodeStateFrame(frame, length, seq, baseSeq, nullptr, decoded, count));
+  TEST_ASSERT_EQUAL_UINT16(7, seq);
+  TEST_ASSERT_EQUAL_UINT8(4, count);
+  TEST_ASSERT_EQUAL_MEMORY(fields, decoded, sizeof(fields));
+}
+
+static void test_state_delta_round_trips_against_base()
+{
+  uint32_t base[3] = {10, 20, 30};
+  uint32_t fields[3] = {10, 5, 31};
+  uint8_t frame[32];
+  uint32_t length = encodeStateFrame(frame, sizeof(frame), 9, base, 8, fields, 3);
+  TEST_ASSERT_TRUE(length > 0);
+
+  uint32_t decoded[STATE_MAX_FIELDS];
+  uint16_t seq, baseSeq;
+  uint8_t count;
+  TEST_ASSERT_TRUE(decodeStateFrame(frame, length, seq, baseSeq, base, decoded, count));
+  TEST_ASSERT_EQUAL_UINT16(8, baseSeq);
+  TEST_ASSERT_EQUAL_MEMORY(fields, decoded, sizeof(fields));
+}
+
+static void test_state_decode_rejects_truncated_frames()
+{
+  uint32_t fields[2] = {1000, 2000};
+  uint8_t frame[32];
+  uint32_t length = encodeStateFrame(frame, sizeof(frame), 1, nullptr, 0, fields, 2);
+
+  uint32_t decoded[STATE_MAX_FIELDS];
+  uint16_t seq, baseSeq;
+  uint8_t count;
+  for(uint32_t cut = 0; cut < length; cut++)
+  {
+    TEST_ASSERT_FALSE(decodeStateFrame(frame, cut, seq, baseSeq, nullptr, decoded, count));
+  }
+}
+
+static void test_io_log_round_trips_and_boot_restarts_clock()
+{
+  uint8_t storage[64];
+  IoLogWriter writer;
+  writer.begin(storage, sizeof(storage));
+  const uint8_t level = 1;
+  TEST_ASSERT_TRUE(writer.append(IO_BOOT, 5, nullptr, 0));
+  TEST_ASSERT_TRUE(writer.append(IO_PIN_LEVEL, 100000, &level, 1));
+  TEST_ASSERT_TRUE(writer.append(IO_BOOT, 3, nullptr, 0));
+
+  IoLogReader reader;
+  reader.begin(storage, writer.used);
+  IoRecord record;
+  TEST_ASSERT_TRUE(reader.next(record));
+  TEST_ASSERT_EQUAL_UINT32(5, record.ms);
+  TEST_ASSERT_TRUE(reader.next(record));
+  TEST_ASSERT_EQUAL(IO_PIN_LEVEL, record.type);
+  TEST_ASSERT_EQUAL_UINT32(100000, record.ms);
+  TEST_ASSERT_EQUAL_UINT8(1, record.data[0]);
+  TEST_ASSERT_TRUE(reader.next(record));
+  TEST_ASSERT_EQUAL_UINT32(3, record.ms);
+  TEST_ASSERT_FALSE(reader.next(record));
+}
+
+static void test_io_log_sync_record_is_absolute()
+{
+  uint8_t storage[32];
+  IoLogWriter writer;
+  writer.begin(storage, sizeof(storage));
+  writer.append(IO_MOTION, 5000, nullptr, 0);
+  // A rotated file: new buffer, clock carried on
+  writer.used = 0;
+  TEST_ASSERT_TRUE(writer.append(IO_SYNC, writer.lastMs, nullptr, 0));
+  TEST_ASSERT_TRUE(writer.append(IO_MOTION, 5200, nullptr, 0));
+
+  IoLogReader reader;
+  reader.begin(storage, writer.used);
+  IoRecord record;
+  TEST_ASSERT_TRUE(reader.next(record));
+  TEST_ASSERT_EQUAL_UINT32(5000, record.ms);
+  TEST_ASSERT_TRUE(reader.next(record));
+  TEST_ASSERT_EQUAL_UINT32(5200, record.ms);
+}
+
+static void test_io_log_writer_refuses_records_that_do_not_fit()
+{
+  uint8_t storage[4];
+  IoLogWriter writer;
+  writer.begin(storage, sizeof(storage));
+  const uint8_t data[2] = {1, 2};
+  TEST_ASSERT_FALSE(writer.append(IO_MQTT_MESSAGE, 0, data, 2));
+  TEST_ASSERT_EQUAL_UINT32(0, writer.used);
+}
+
+static void test_history_columns_pack_and_lay_out()
+{
+  uint8_t packed[4];
+  historyPack(packed, 0x12345678, 4);
+  TEST_ASSERT_EQUAL_UINT32(0x12345678, historyUnpack(packed, 4));
+  historyPack(packed, 0x1ff, 1);
+  TEST_ASSERT_EQUAL_UINT32(0xff, historyUnpack(packed, 1));
+
+  TEST_ASSERT_EQUAL_UINT32(HISTORY_HEADER_SIZE, historyColumnOffset(HISTORY_HOUR, 10));
+  TEST_ASSERT_EQUAL_UINT32(HISTORY_HEADER_SIZE + 40, historyColumnOffset(HISTORY_OCCUPIED_SECONDS, 10));
+  TEST_ASSERT_EQUAL_UINT32(HISTORY_HEADER_SIZE + HISTORY_ROW_SIZE * 10, historyFileSize(10));
+  TEST_ASSERT_EQUAL_UINT8(6, historyRowOffset(HISTORY_ENTRIES));
+  TEST_ASSERT_EQUAL_UINT8(HISTORY_ROW_SIZE, historyRowOffset(HISTORY_COLUMNS));
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_state_keyframe_round_trips);
+  RUN_TEST(test_state_delta_round_trips_against_base);
+  RUN_TEST(test_state_decode_rejects_truncated_frames);
+  RUN_TEST(test_io_log_round_trips_and_boot_restarts_clock);
+  RUN_TEST(test_io_log_sync_record_is_absolute);
+  RUN_TEST(test_io_log_writer_refuses_records_that_do_not_fit);
+  RUN_TEST(test_history_columns_pack_and_lay_out);
+  return UNITY_END();
+}
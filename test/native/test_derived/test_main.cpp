@@ -0,0 +1,74 @@
+#include <unity.h>
+#include <SpottyCore.h>
+
+static int32_t source;
+static int computes;
+static DerivedValue input;
+static DerivedValue doubled;
+
+static int32_t computeInput(uint32_t nowMs, uint32_t& validMs)
+{
+  computes++;
+  validMs = 100;
+  return source;
+}
+
+static int32_t computeDoubled(uint32_t nowMs, uint32_t& validMs)
+{
+  return input.get(nowMs, validMs) * 2;
+}
+
+void setUp()
+{
+  source = 1;
+  computes = 0;
+  input.begin(computeInput);
+  doubled.begin(computeDoubled);
+  doubled.dependsOn(input);
+}
+
+void tearDown() {}
+
+static void test_derived_value_is_cached_until_invalidated()
+{
+  TEST_ASSERT_EQUAL_INT(2, doubled.get(0));
+  TEST_ASSERT_EQUAL_INT(2, doubled.get(50));
+  TEST_ASSERT_EQUAL_INT(1, computes);
+
+  source = 3;
+  TEST_ASSERT_EQUAL_INT(2, doubled.get(60));
+  input.invalidate();
+  TEST_ASSERT_EQUAL_INT(6, doubled.get(61));
+  TEST_ASSERT_EQUAL_INT(2, computes);
+}
+
+static void test_derived_value_inherits_input_validity()
+{
+  doubled.get(0);
+  source = 4;
+  TEST_ASSERT_EQUAL_INT(2, doubled.get(99));
+  TEST_ASSERT_EQUAL_INT(8, doubled.get(100));
+  TEST_ASSERT_EQUAL_UINT32(2, doubled.evaluations);
+  TEST_ASSERT_EQUAL_UINT32(3, doubled.reads);
+}
+
+static void test_derived_value_limits_dependents()
+{
+  DerivedValue extra[DERIVED_MAX_DEPENDENTS];
+  for(int i = 0; i < DERIVED_MAX_DEPENDENTS - 1; i++)
+  {
+    extra[i].begin(computeDoubled);
+    TEST_ASSERT_TRUE(extra[i].dependsOn(input));
+  }
+  extra[DERIVED_MAX_DEPENDENTS - 1].begin(computeDoubled);
+  TEST_ASSERT_FALSE(extra[DERIVED_MAX_DEPENDENTS - 1].dependsOn(input));
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_derived_value_is_cached_until_invalidated);
+  RUN_TEST(test_derived_value_inherits_input_validity);
+  RUN_TEST(test_derived_value_limits_dependents);
+  return UNITY_END();
+}
@@ -0,0 +1,88 @@
+#include <unity.h>
+#include <SpottyCore.h>
+
+void setUp() {}
+void tearDown() {}
+
+static void test_link_grade_follows_rssi_rtt_and_failures()
+{
+  LinkQuality link;
+  LinkThresholds thresholds = {-75, -85, 50000, 250000};
+  link.begin(thresholds);
+  link.onPublish(1000, true, -60);
+  TEST_ASSERT_EQUAL(LINK_GOOD, link.grade());
+  link.onPublish(1000, true, -80);
+  TEST_ASSERT_EQUAL(LINK_DEGRADED, link.grade());
+  link.onPublish(1000, true, -90);
+  TEST_ASSERT_EQUAL(LINK_POOR, link.grade());
+  link.onPublish(1000, false, -60);
+  link.onPublish(1000, false, -60);
+  TEST_ASSERT_EQUAL(LINK_POOR, link.grade());
+}
+
+static void test_broker_selector_backs_off_failed_brokers()
+{
+  BrokerSelector brokers;
+  brokers.begin(2, 1000, 30000);
+  TEST_ASSERT_EQUAL_INT(0, brokers.pick(0, -1));
+  brokers.onConnect(0, false, 1500, 0);
+  TEST_ASSERT_EQUAL_INT(1, brokers.pick(10, -1));
+  brokers.onConnect(1, false, 1500, 10);
+  TEST_ASSERT_EQUAL_INT(-1, brokers.pick(20, -1));
+  TEST_ASSERT_EQUAL_INT(0, brokers.pick(1000, -1));
+}
+
+static void test_broker_selector_prefers_healthy_and_caps_backoff()
+{
+  BrokerSelector brokers;
+  brokers.begin(2, 1000, 30000);
+  brokers.onConnect(1, true, 50, 0);
+  brokers.onConnect(0, true, 500, 0);
+  TEST_ASSERT_EQUAL_INT(1, brokers.pick(0, -1));
+  TEST_ASSERT_EQUAL_INT(0, brokers.pick(0, 1));
+  brokers.onDrop(1, 100);
+  TEST_ASSERT_EQUAL_INT(0, brokers.pick(100, -1));
+  for(int i = 0; i < 40; i++)
+  {
+    brokers.onConnect(0, false, 1, 0);
+  }
+  TEST_ASSERT_EQUAL_UINT32(30000, brokers.retryAt[0]);
+}
+
+static void test_flow_estimator_predicts_after_min_samples()
+{
+  FlowEstimator flow;
+  flow.begin(60000, 3600000, 0);
+  uint32_t now = 0;
+  for(int i = 0; i < 4; i++)
+  {
+    TEST_ASSERT_EQUAL_INT(-1, flow.onUpstream(0, now, 5));
+    flow.onLocalArrival(now + 1000);
+    now += 120000;
+  }
+  // The fifth passer-by counts before its arrival can
+  TEST_ASSERT_EQUAL_INT(80, flow.onUpstream(0, now, 5));
+}
+
+static void test_anomaly_detector_flags_stuck_high()
+{
+  AnomalyDetector detector;
+  AnomalyConfig config = {60000, 30, 4, 3600000, 2};
+  detector.begin(config, 0);
+  TEST_ASSERT_EQUAL(FAULT_NONE, detector.update(0, 1, true, -1));
+  TEST_ASSERT_EQUAL(FAULT_NONE, detector.update(60000, 1, true, -1));
+  TEST_ASSERT_EQUAL(FAULT_STUCK_HIGH, detector.update(60001, 1, true, -1));
+  TEST_ASSERT_TRUE(detector.suppressing());
+  TEST_ASSERT_EQUAL(FAULT_NONE, detector.update(60002, 2, false, -1));
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_link_grade_follows_rssi_rtt_and_failures);
+  RUN_TEST(test_broker_selector_backs_off_failed_brokers);
+  RUN_TEST(test_broker_selector_prefers_healthy_and_caps_backoff);
+  RUN_TEST(test_flow_estimator_predicts_after_min_samples);
+  RUN_TEST(test_anomaly_detector_flags_stuck_high);
+  return UNITY_END();
+}
@@ -0,0 +1,170 @@
+#include <unity.h>
+#include <SpottyCore.h>
+
+void setUp() {}
+void tearDown() {}
+
+static void test_occupancy_enters_refreshes_and_vacates()
+{
+  Occupancy occupancy;
+  occupancy.begin(2000);
+  TEST_ASSERT_EQUAL(OCCUPANCY_ENTERED, occupancy.onMotion(100, 1));
+  TEST_ASSERT_EQUAL(OCCUPANCY_REFRESHED, occupancy.onMotion(500, 2));
+  TEST_ASSERT_EQUAL(OCCUPANCY_NONE, occupancy.tick(2500));
+  TEST_ASSERT_EQUAL(OCCUPANCY_VACATED, occupancy.tick(2501));
+  TEST_ASSERT_FALSE(occupancy.occupied);
+}
+
+static void test_occupancy_counts_coalesced_edges()
+{
+  Occupancy occupancy;
+  occupancy.begin(2000);
+  occupancy.onMotion(100, 1);
+  occupancy.onMotion(200, 4);
+  TEST_ASSERT_EQUAL_UINT32(2, occupancy.coalesced);
+}
+
+static void test_occupancy_holds_while_a_sensor_is_high()
+{
+  Occupancy occupancy;
+  occupancy.begin(2000);
+  occupancy.onLevel(0, true, 100);
+  occupancy.onMotion(100, 1);
+  TEST_ASSERT_EQUAL(OCCUPANCY_NONE, occupancy.tick(10000));
+  // The hold runs from the falling edge
+  occupancy.onLevel(0, false, 10000);
+  TEST_ASSERT_EQUAL(OCCUPANCY_NONE, occupancy.tick(12000));
+  TEST_ASSERT_EQUAL(OCCUPANCY_VACATED, occupancy.tick(12001));
+}
+
+static void test_occupancy_drops_a_sensor_stuck_high()
+{
+  Occupancy occupancy;
+  occupancy.begin(2000, 60000);
+  occupancy.onLevel(0, true, 100);
+  occupancy.onMotion(100, 1);
+  TEST_ASSERT_EQUAL(OCCUPANCY_NONE, occupancy.tick(60100));
+  // Past the cap the sensor no longer holds the room, and the hold ran out long ago
+  TEST_ASSERT_EQUAL(OCCUPANCY_VACATED, occupancy.tick(60101));
+  // A resync that still reads HIGH does not re-arm it
+  occupancy.onLevel(0, true, 60200);
+  TEST_ASSERT_EQUAL_UINT8(0, occupancy.highSensors);
+  // A falling edge clears it, and the next rise holds again
+  occupancy.onLevel(0, false, 70000);
+  occupancy.onLevel(0, true, 70000);
+  TEST_ASSERT_EQUAL_UINT8(1, occupancy.highSensors);
+}
+
+static void test_occupancy_vacates_while_a_flooding_sensor_is_suppressed()
+{
+  Occupancy occupancy;
+  occupancy.begin(2000);
+  occupancy.onMotion(100, 1);
+  occupancy.setSuppressed(true, 500);
+  uint32_t now = 500;
+  for(int i = 0; i < 100; i++, now += 50)
+  {
+    occupancy.onLevel(0, i % 2 == 0, now);
+    TEST_ASSERT_EQUAL(now > 2500 ? OCCUPANCY_VACATED : OCCUPANCY_NONE, occupancy.tick(now));
+    if(!occupancy.occupied)
+    {
+      break;
+    }
+  }
+  TEST_ASSERT_FALSE(occupancy.occupied);
+  TEST_ASSERT_EQUAL_UINT8(0, occupancy.highSensors);
+
+  // Levels count again once suppression ends
+  occupancy.setSuppressed(false, now);
+  occupancy.onLevel(0, true, now);
+  TEST_ASSERT_EQUAL_UINT8(1, occupancy.highSensors);
+}
+
+static void test_token_bucket_refills_over_time()
+{
+  TokenBucket bucket;
+  bucket.begin(2, 1000, 0);
+  TEST_ASSERT_TRUE(bucket.take(0));
+  TEST_ASSERT_TRUE(bucket.take(0));
+  TEST_ASSERT_FALSE(bucket.take(0));
+  TEST_ASSERT_FALSE(bucket.take(999));
+  TEST_ASSERT_TRUE(bucket.take(1000));
+}
+
+static void test_edge_ring_is_fifo_and_counts_overflows()
+{
+  EdgeRing ring = {};
+  for(uint32_t i = 0; i < EDGE_RING_SIZE; i++)
+  {
+    ring.push(i, 0, 0, 1);
+  }
+  // One slot stays free to tell full from empty
+  TEST_ASSERT_EQUAL_UINT32(1, ring.overflows);
+
+  EdgeEvent event;
+  for(uint32_t i = 0; i < EDGE_RING_SIZE - 1; i++)
+  {
+    TEST_ASSERT_TRUE(ring.pop(event));
+    TEST_ASSERT_EQUAL_UINT32(i, event.ms);
+  }
+  TEST_ASSERT_FALSE(ring.pop(event));
+}
+
+static void test_people_counter_expires_zones()
+{
+  PeopleCounter counter;
+  counter.begin(2, 1000);
+  TEST_ASSERT_TRUE(counter.onZoneMotion(0, 0));
+  TEST_ASSERT_TRUE(counter.onZoneMotion(1, 600));
+  TEST_ASSERT_EQUAL_UINT8(2, counter.count());
+  // Zone 0's evidence is older than half the hold
+  TEST_ASSERT_EQUAL_UINT8(1, counter.low(700));
+  TEST_ASSERT_TRUE(counter.tick(1001));
+  TEST_ASSERT_EQUAL_UINT8(1, counter.count());
+  TEST_ASSERT_TRUE(counter.tick(1601));
+  TEST_ASSERT_EQUAL_UINT8(0, counter.count());
+}
+
+static void test_people_counter_holds_a_zone_while_its_sensor_is_high()
+{
+  PeopleCounter counter;
+  counter.begin(2, 2000);
+  counter.onZoneMotion(0, 0);
+  counter.onLevel(0, true, 0);
+  // A 10 s pulse against a 2 s hold
+  for(uint32_t now = 0; now <= 10000; now += 500)
+  {
+    TEST_ASSERT_FALSE(counter.tick(now));
+    TEST_ASSERT_EQUAL_UINT8(1, counter.count());
+    TEST_ASSERT_EQUAL_UINT8(1, counter.low(now));
+  }
+  // The hold runs from the falling edge
+  counter.onLevel(0, false, 10000);
+  TEST_ASSERT_FALSE(counter.tick(12000));
+  TEST_ASSERT_TRUE(counter.tick(12001));
+  TEST_ASSERT_EQUAL_UINT8(0, counter.count());
+}
+
+static void test_people_counter_counts_a_high_zone_whose_rise_was_missed()
+{
+  PeopleCounter counter;
+  counter.begin(2, 2000);
+  TEST_ASSERT_TRUE(counter.onLevel(1, true, 100));
+  TEST_ASSERT_EQUAL_UINT8(1, counter.count());
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_occupancy_enters_refreshes_and_vacates);
+  RUN_TEST(test_occupancy_counts_coalesced_edges);
+  RUN_TEST(test_occupancy_holds_while_a_sensor_is_high);
+  RUN_TEST(test_occupancy_drops_a_sensor_stuck_high);
+  RUN_TEST(test_occupancy_vacates_while_a_flooding_sensor_is_suppressed);
+  RUN_TEST(test_token_bucket_refills_over_time);
+  RUN_TEST(test_edge_ring_is_fifo_and_counts_overflows);
+  RUN_TEST(test_people_counter_expires_zones);
+  RUN_TEST(test_people_counter_holds_a_zone_while_its_sensor_is_high);
+  RUN_TEST(test_people_counter_counts_a_high_zone_whose_rise_was_missed);
+  return UNITY_END();
+}
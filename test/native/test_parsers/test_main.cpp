@@ -0,0 +1,137 @@
+#include <unity.h>
+#include <string.h>
+#include <SpottyCore.h>
+
+void setUp() {}
+void tearDown() {}
+
+static const char* const fieldNames[] = {"occupied", "count"};
+
+static void test_config_delta_parses_apply_and_rollback()
+{
+  const uint8_t apply[] = {1, 0, 3, 0, 4, 1, 2, 0, 0, 0x27, 0x10};
+  ConfigDelta delta;
+  TEST_ASSERT_TRUE(delta.parse(apply, sizeof(apply)));
+  TEST_ASSERT_EQUAL_UINT16(3, delta.baseVersion);
+  TEST_ASSERT_EQUAL_UINT16(4, delta.version);
+  TEST_ASSERT_EQUAL_UINT8(1, delta.count);
+  TEST_ASSERT_EQUAL_UINT8(2, delta.entries[0].key);
+  TEST_ASSERT_EQUAL_UINT32(10000, delta.entries[0].value);
+
+  const uint8_t rollback[] = {2, 0, 4};
+  TEST_ASSERT_TRUE(delta.parse(rollback, sizeof(rollback)));
+  TEST_ASSERT_EQUAL(CONFIG_DELTA_ROLLBACK, delta.type);
+  TEST_ASSERT_EQUAL_UINT16(4, delta.version);
+}
+
+static void test_config_delta_rejects_bad_lengths()
+{
+  const uint8_t apply[] = {1, 0, 3, 0, 4, 2, 2, 0, 0, 0x27, 0x10};
+  ConfigDelta delta;
+  TEST_ASSERT_FALSE(delta.parse(apply, sizeof(apply)));
+  TEST_ASSERT_FALSE(delta.parse(apply, 2));
+  const uint8_t rollback[] = {2, 0, 4, 0};
+  TEST_ASSERT_FALSE(delta.parse(rollback, sizeof(rollback)));
+}
+
+static void test_schedule_parses_and_wraps_midnight()
+{
+  Schedule schedule = {};
+  const char* table = "23:00=1,07:00=0";
+  TEST_ASSERT_TRUE(schedule.parse((const uint8_t*)table, strlen(table), 2));
+  TEST_ASSERT_EQUAL_UINT8(1, schedule.profileAt(3 * 3600));
+  TEST_ASSERT_EQUAL_UINT8(0, schedule.profileAt(12 * 3600));
+  TEST_ASSERT_EQUAL_UINT8(1, schedule.profileAt(23 * 3600 + 1));
+  TEST_ASSERT_EQUAL_UINT32(3600, schedule.secondsUntilNext(6 * 3600));
+  TEST_ASSERT_EQUAL_UINT32(8 * 3600, schedule.secondsUntilNext(23 * 3600));
+}
+
+static void test_schedule_rejects_invalid_input_and_keeps_table()
+{
+  Schedule schedule = {};
+  const char* table = "07:00=0";
+  schedule.parse((const uint8_t*)table, strlen(table), 2);
+  const char* bad[] = {"24:00=0", "07:60=0", "07:00=2", "07:00", "07-00=1", ""};
+  for(const char* text : bad)
+  {
+    TEST_ASSERT_FALSE(schedule.parse((const uint8_t*)text, strlen(text), 2));
+  }
+  TEST_ASSERT_EQUAL_UINT8(1, schedule.count);
+}
+
+static void test_payload_template_renders_fields_and_choices()
+{
+  PayloadTemplate format;
+  const char* source = "${occupied?ON:OFF} n=${count}";
+  TEST_ASSERT_TRUE(format.compile(source, strlen(source), fieldNames, 2));
+
+  char out[32];
+  uint32_t values[2] = {1, 42};
+  TEST_ASSERT_EQUAL_UINT32(7, format.render(values, out, sizeof(out)));
+  TEST_ASSERT_EQUAL_STRING("ON n=42", out);
+  values[0] = 0;
+  format.render(values, out, sizeof(out));
+  TEST_ASSERT_EQUAL_STRING("OFF n=42", out);
+  // Does not fit: nothing rendered
+  TEST_ASSERT_EQUAL_UINT32(0, format.render(values, out, 4));
+}
+
+static void test_payload_template_rejects_unknown_and_unterminated_fields()
+{
+  PayloadTemplate format;
+  const char* bad[] = {"${nope}", "${count", "${occupied?ON}", ""};
+  for(const char* source : bad)
+  {
+    TEST_ASSERT_FALSE(format.compile(source, strlen(source), fieldNames, 2));
+  }
+  TEST_ASSERT_FALSE(format.compile("a\0b", 3, fieldNames, 2));
+}
+
+static void test_topic_filters_match_wildcards()
+{
+  TEST_ASSERT_TRUE(topicMatches("a/+/c", "a/b/c"));
+  TEST_ASSERT_FALSE(topicMatches("a/+/c", "a/b/d"));
+  TEST_ASSERT_TRUE(topicMatches("a/#", "a/b/c"));
+  TEST_ASSERT_TRUE(topicMatches("a/#", "a"));
+  TEST_ASSERT_FALSE(topicMatches("a/b", "a/bc"));
+  TEST_ASSERT_TRUE(topicHash("motionConfig") != topicHash("motionConfih"));
+}
+
+static const char* routedTopic;
+
+static void onRouted(const char* topic, const uint8_t* payload, unsigned int length)
+{
+  routedTopic = topic;
+}
+
+static void test_topic_router_dispatches_first_match_and_fills_up()
+{
+  TopicRoute table[2];
+  TopicRouter router;
+  router.begin(table, 2);
+  TEST_ASSERT_TRUE(router.add("a/+", onRouted));
+  TEST_ASSERT_TRUE(router.add("b/#", onRouted));
+  TEST_ASSERT_FALSE(router.add("c", onRouted));
+
+  routedTopic = nullptr;
+  TEST_ASSERT_TRUE(router.dispatch("a/x", nullptr, 0));
+  TEST_ASSERT_EQUAL_STRING("a/x", routedTopic);
+  // Second delivery comes from the cache
+  TEST_ASSERT_TRUE(router.dispatch("a/x", nullptr, 0));
+  TEST_ASSERT_FALSE(router.dispatch("a/x/y", nullptr, 0));
+  TEST_ASSERT_TRUE(router.dispatch("b/x/y", nullptr, 0));
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_config_delta_parses_apply_and_rollback);
+  RUN_TEST(test_config_delta_rejects_bad_lengths);
+  RUN_TEST(test_schedule_parses_and_wraps_midnight);
+  RUN_TEST(test_schedule_rejects_invalid_input_and_keeps_table);
+  RUN_TEST(test_payload_template_renders_fields_and_choices);
+  RUN_TEST(test_payload_template_rejects_unknown_and_unterminated_fields);
+  RUN_TEST(test_topic_filters_match_wildcards);
+  RUN_TEST(test_topic_router_dispatches_first_match_and_fills_up);
+  return UNITY_END();
+}
@@ -0,0 +1,59 @@
+#include <unity.h>
+#include <SpottyCore.h>
+
+static const PowerModel model = {{170000, 80000, 56000, 15000, 900}};
+
+void setUp() {}
+void tearDown() {}
+
+static void test_power_model_prices_phase_time()
+{
+  PhaseTimer timer;
+  timer.begin(PHASE_LISTEN, 0);
+  uint32_t now = 0;
+  // An hour of listening, folded in once a second
+  for(int i = 0; i < 3600; i++)
+  {
+    now += 1000000;
+    timer.enter(PHASE_LISTEN, now);
+  }
+  TEST_ASSERT_EQUAL_UINT32(56000, model.chargeUah(timer));
+  TEST_ASSERT_EQUAL_UINT32(56000, model.averageUa(timer));
+
+  timer.enter(PHASE_TX, now);
+  timer.enter(PHASE_LISTEN, now + 3600000000u);
+  TEST_ASSERT_EQUAL_UINT32(226000, model.chargeUah(timer));
+  TEST_ASSERT_EQUAL_UINT32(113000, model.averageUa(timer));
+}
+
+static void test_power_model_estimates_battery_life()
+{
+  // 24 one-second wakes at 80 mA a day and 20 uA asleep from 2000 mAh
+  TEST_ASSERT_EQUAL_UINT32(47368, PowerModel::batteryLifeHours(2000, 24, 80000000, 20));
+  TEST_ASSERT_EQUAL_UINT32(0xffffffff, PowerModel::batteryLifeHours(2000, 0, 0, 0));
+}
+
+static void test_cycle_histogram_buckets_by_log2()
+{
+  CycleHistogram histogram;
+  histogram.begin(6);
+  histogram.record(10);
+  histogram.record(64);
+  histogram.record(200);
+  histogram.record(1000000);
+  TEST_ASSERT_EQUAL_UINT32(1, histogram.buckets[0]);
+  TEST_ASSERT_EQUAL_UINT32(1, histogram.buckets[1]);
+  TEST_ASSERT_EQUAL_UINT32(1, histogram.buckets[2]);
+  TEST_ASSERT_EQUAL_UINT32(1, histogram.buckets[CYCLE_HISTOGRAM_BUCKETS - 1]);
+  TEST_ASSERT_EQUAL_UINT32(1000000, histogram.maxCycles);
+  TEST_ASSERT_EQUAL_UINT32(4, histogram.samples());
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_power_model_prices_phase_time);
+  RUN_TEST(test_power_model_estimates_battery_life);
+  RUN_TEST(test_cycle_histogram_buckets_by_log2);
+  return UNITY_END();
+}